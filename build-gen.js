@@ -4,7 +4,7 @@ const args = process.argv.slice(2);
 
 (async () => {
   await build({
-	 entryPoints: ['./src/ui/gen-native-palette.ts'],
+	 entryPoints: ['./src/ui/gen-native.ts'],
 	 minify: false,
 	 sourcemap: false,
 	 bundle: true,
@@ -3,13 +3,23 @@
     "target_name": "native-layer",
     "cflags!": [ "-fno-exceptions" ],
     "cflags_cc!": [ "-fno-exceptions" ],
+    "cflags": [ "-ffp-contract=off" ],
     "sources": [
       "src/native-layer.cc",
       "src/stb.cc",
       "src/gl-texture.cc",
       "src/gl-framebuffer.cc",
       "src/gl-program.cc",
+      "src/gl-resources.cc",
+      "src/gl-state.cc",
+      "src/shader-variants.cc",
+      "src/frame-capture.cc",
+      "src/event-log.cc",
+      "src/exec-engine.cc",
+      "src/virtual-gen.cc",
       "src/sample.cc",
+      "src/stream.cc",
+      "src/tag-layout.cc",
     ],
     'include_dirs': [
       "<!@(node -p \"require('node-addon-api').include\")"
@@ -0,0 +1,155 @@
+#include <cstring>
+
+#include "event-log.hh"
+
+namespace {
+
+const char MAGIC[8] = {'U', 'P', 'S', 'E', 'V', 'T', '0', '1'};
+
+void putVarint(FILE *f, uint64_t v) {
+  while (v >= 0x80) {
+    fputc((v & 0x7f) | 0x80, f);
+    v >>= 7;
+  }
+  fputc(v, f);
+}
+
+bool getVarint(const std::vector<unsigned char> &buf, size_t &pos,
+               uint64_t &v) {
+  v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (pos >= buf.size()) {
+      return false;
+    }
+    unsigned char byte = buf[pos++];
+    v |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+EventRecorder::EventRecorder(const std::string &path) {
+  this->_file = fopen(path.c_str(), "wb");
+  if (this->_file) {
+    fwrite(MAGIC, 1, sizeof(MAGIC), this->_file);
+  }
+  this->_last = std::chrono::steady_clock::now();
+}
+
+EventRecorder::~EventRecorder() {
+  if (this->_file) {
+    fclose(this->_file);
+  }
+}
+
+void EventRecorder::record(EventKind kind, SDL_Keycode keycode) {
+  auto now = std::chrono::steady_clock::now();
+  uint64_t delta_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(now - this->_last)
+          .count();
+  this->_last = now;
+
+  putVarint(this->_file, delta_us);
+  putVarint(this->_file, kind);
+  putVarint(this->_file, (uint32_t)keycode);
+  this->_count++;
+}
+
+Napi::FunctionReference EventReplay::constructor;
+
+Napi::Object EventReplay::Init(Napi::Env env, Napi::Object exports) {
+  Napi::Function func = DefineClass(
+      env, "EventReplay",
+      {
+          EventReplay::InstanceMethod("next", &EventReplay::next),
+          EventReplay::InstanceMethod("length", &EventReplay::length),
+          EventReplay::InstanceMethod("rewind", &EventReplay::rewind),
+      });
+
+  EventReplay::constructor = Napi::Persistent(func);
+  constructor.SuppressDestruct();
+
+  exports.Set(Napi::String::New(env, "EventReplay"), func);
+
+  return exports;
+}
+
+EventReplay::EventReplay(const Napi::CallbackInfo &info) : ObjectWrap(info) {
+  NBOILER();
+
+  if (info.Length() < 1) {
+    throwJs(env, "usage: EventReplay(path: string)");
+    return;
+  }
+
+  if (!info[0].IsString()) {
+    throwJs(env, "argument 0 should be a string");
+    return;
+  }
+
+  std::string path = info[0].As<Napi::String>().Utf8Value();
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f) {
+    throwJs(env, "couldn't open event log " + path);
+    return;
+  }
+  std::vector<unsigned char> buf;
+  unsigned char chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    buf.insert(buf.end(), chunk, chunk + n);
+  }
+  fclose(f);
+
+  if (buf.size() < sizeof(MAGIC) || memcmp(buf.data(), MAGIC, sizeof(MAGIC))) {
+    throwJs(env, "not an event log: " + path);
+    return;
+  }
+
+  // A truncated final record (say, from a crash mid-write) is ignored
+  size_t pos = sizeof(MAGIC);
+  uint64_t time_us = 0;
+  while (pos < buf.size()) {
+    uint64_t delta, kind, keycode;
+    if (!getVarint(buf, pos, delta) || !getVarint(buf, pos, kind) ||
+        !getVarint(buf, pos, keycode)) {
+      break;
+    }
+    time_us += delta;
+    this->_events.push_back(
+        {time_us, (EventKind)kind, (SDL_Keycode)(uint32_t)keycode});
+  }
+}
+
+// Returns the next event as { t, key }, with t in milliseconds since
+// the start of the recording and key as pollEvent would have returned
+// it, or null at the end of the log.
+NFUNC(EventReplay::next) {
+  NBOILER();
+
+  if (this->_pos >= this->_events.size()) {
+    return env.Null();
+  }
+  const Event &event = this->_events[this->_pos++];
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("t", Napi::Number::New(env, event.time_us / 1000.0));
+  result.Set("key", Napi::String::New(env, SDL_GetKeyName(event.keycode)));
+
+  return result;
+}
+
+NFUNC(EventReplay::length) {
+  NBOILER();
+  return Napi::Number::New(env, this->_events.size());
+}
+
+NFUNC(EventReplay::rewind) {
+  NBOILER();
+  this->_pos = 0;
+  return env.Null();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <SDL2/SDL.h>
+#include <napi.h>
+
+#include "napi-helpers.hh"
+
+// Input logs are a magic header followed by one record per event,
+// each a sequence of LEB128 varints:
+//   microseconds since the previous event (or since recording began)
+//   event kind (only EVENT_KEYDOWN so far)
+//   SDL keycode
+// Timestamps come from a monotonic clock, so they're unaffected by
+// wall clock adjustments during a session.
+
+enum EventKind { EVENT_KEYDOWN = 0 };
+
+class EventRecorder {
+public:
+  EventRecorder(const std::string &path);
+  ~EventRecorder();
+  bool ok() { return this->_file != nullptr; }
+  void record(EventKind kind, SDL_Keycode keycode);
+  size_t count() { return this->_count; }
+
+private:
+  FILE *_file;
+  std::chrono::steady_clock::time_point _last;
+  size_t _count = 0;
+};
+
+// Reads back a log written by EventRecorder, handing events out one at
+// a time in order.
+class EventReplay : public Napi::ObjectWrap<EventReplay> {
+public:
+  EventReplay(const Napi::CallbackInfo &info);
+  NFUNC(next);
+  NFUNC(length);
+  NFUNC(rewind);
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+  static Napi::FunctionReference constructor;
+
+private:
+  struct Event {
+    uint64_t time_us; // since start of recording
+    EventKind kind;
+    SDL_Keycode keycode;
+  };
+
+  std::vector<Event> _events;
+  size_t _pos = 0;
+};
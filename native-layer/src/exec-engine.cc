@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <string>
+
+#include "exec-engine.hh"
+
+Napi::FunctionReference ExecEngine::constructor;
+
+Napi::Object ExecEngine::Init(Napi::Env env, Napi::Object exports) {
+  Napi::Function func =
+      DefineClass(env, "ExecEngine",
+                  {
+                      ExecEngine::InstanceMethod("run", &ExecEngine::run),
+                  });
+
+  ExecEngine::constructor = Napi::Persistent(func);
+  constructor.SuppressDestruct();
+
+  exports.Set(Napi::String::New(env, "ExecEngine"), func);
+
+  return exports;
+}
+
+ExecEngine::ExecEngine(const Napi::CallbackInfo &info) : ObjectWrap(info) {
+  NBOILER();
+
+  if (info.Length() < 1 || !info[0].IsArray()) {
+    throwJs(env, "usage: ExecEngine(programs: (CompiledExecutable | null)[])");
+    return;
+  }
+
+  Napi::Array programs = info[0].As<Napi::Array>();
+  for (uint32_t i = 0; i < programs.Length(); i++) {
+    Napi::Value value = programs.Get(i);
+    if (!value.IsObject()) {
+      this->_programs.push_back({false, 0, 0, {}});
+      continue;
+    }
+
+    Napi::Object obj = value.As<Napi::Object>();
+    Napi::Value cpu_cost = obj.Get("cpuCost");
+    Napi::Value num_targets = obj.Get("numTargets");
+    Napi::Value code_value = obj.Get("code");
+    if (!cpu_cost.IsNumber() || !num_targets.IsNumber() ||
+        !code_value.IsArray()) {
+      throwJs(env, "program " + std::to_string(i) +
+                       " should have cpuCost, numTargets and code");
+      return;
+    }
+    Program program = {
+        true,
+        cpu_cost.As<Napi::Number>().DoubleValue(),
+        num_targets.As<Napi::Number>().Int32Value(),
+        {},
+    };
+    if (program.num_targets < 0 || program.num_targets > max_targets) {
+      throwJs(env, "program " + std::to_string(i) + " has too many targets");
+      return;
+    }
+
+    Napi::Array code = code_value.As<Napi::Array>();
+    if (code.Length() % instr_size != 0) {
+      throwJs(env, "program " + std::to_string(i) + " has a partial instr");
+      return;
+    }
+    for (uint32_t pc = 0; pc < code.Length(); pc += instr_size) {
+      int n[instr_size];
+      for (int j = 0; j < instr_size; j++) {
+        Napi::Value v = code.Get(pc + j);
+        if (!v.IsNumber()) {
+          throwJs(env, "program " + std::to_string(i) +
+                           " has a non-number at " + std::to_string(pc + j));
+          return;
+        }
+        n[j] = v.As<Napi::Number>().Int32Value();
+      }
+      Instr instr = {n[0], n[1], n[2], n[3]};
+
+      // Target operands are checked here so runSteps() only has to check
+      // the step tables.
+      auto isTarget = [&](int t) {
+        return t >= 0 && t < program.num_targets;
+      };
+      bool ok = false;
+      switch (instr.op) {
+      case op_add_cpu:
+      case op_require:
+        ok = isTarget(instr.a);
+        break;
+      case op_mov_cpu:
+        ok = isTarget(instr.a) && isTarget(instr.b);
+        break;
+      case op_toggle_acl:
+        ok = isTarget(instr.a) && instr.b >= 0 && instr.b < num_acl_bits;
+        break;
+      }
+      if (!ok) {
+        throwJs(env, "program " + std::to_string(i) + " has a bad instr at " +
+                         std::to_string(pc));
+        return;
+      }
+      program.code.push_back(instr);
+    }
+
+    this->_programs.push_back(program);
+  }
+}
+
+int ExecEngine::runSteps(Napi::Env env, double *items, size_t num_items,
+                         const int32_t *steps, size_t num_steps) {
+  // Check everything up front, so a bad table can't leave the batch half
+  // applied.
+  for (size_t i = 0; i < num_steps; i++) {
+    const int32_t *step = steps + i * step_size;
+    auto isSlot = [&](int32_t slot) {
+      return slot >= 0 && (size_t)slot < num_items;
+    };
+    int32_t p = step[1];
+    if (p < 0 || (size_t)p >= this->_programs.size() ||
+        !this->_programs[p].compiled) {
+      throwJs(env, "step " + std::to_string(i) + " has no program");
+      return -1;
+    }
+    bool ok = (step[0] == step_start || step[0] == step_finish) &&
+              isSlot(step[2]);
+    for (int t = 0; t < this->_programs[p].num_targets; t++) {
+      ok = ok && isSlot(step[3 + t]);
+    }
+    if (!ok) {
+      throwJs(env, "step " + std::to_string(i) + " is malformed");
+      return -1;
+    }
+  }
+
+  for (size_t i = 0; i < num_steps; i++) {
+    const int32_t *step = steps + i * step_size;
+    const Program &program = this->_programs[step[1]];
+    double *actor = items + step[2] * item_size;
+    auto target = [&](int t) { return items + step[3 + t] * item_size; };
+    auto touch = [](double *item, int bits) {
+      item[2] = (int)item[2] | bits;
+    };
+
+    if (step[0] == step_start) {
+      if (actor[0] < program.cpu_cost) {
+        return (int)i;
+      }
+      actor[0] -= program.cpu_cost;
+      touch(actor, touched_cpu);
+      continue;
+    }
+
+    for (const Instr &instr : program.code) {
+      if (instr.op == op_require && !((int)target(instr.a)[1] & instr.b) &&
+          !((int)actor[1] & instr.c)) {
+        return (int)i;
+      }
+    }
+    for (const Instr &instr : program.code) {
+      switch (instr.op) {
+      case op_add_cpu:
+        target(instr.a)[0] += instr.b;
+        touch(target(instr.a), touched_cpu);
+        break;
+      case op_mov_cpu: {
+        double amount = std::min((double)instr.c, target(instr.a)[0]);
+        target(instr.a)[0] -= amount;
+        target(instr.b)[0] += amount;
+        touch(target(instr.a), touched_cpu);
+        touch(target(instr.b), touched_cpu);
+        break;
+      }
+      case op_toggle_acl:
+        target(instr.a)[1] = (int)target(instr.a)[1] ^ (1 << instr.b);
+        touch(target(instr.a), touched_acl << instr.b);
+        break;
+      }
+    }
+  }
+  return (int)num_steps;
+}
+
+// run(items: Float64Array, steps: Int32Array): number
+NFUNC(ExecEngine::run) {
+  NBOILER();
+
+  if (info.Length() < 2 || !info[0].IsTypedArray() ||
+      !info[1].IsTypedArray() ||
+      info[0].As<Napi::TypedArray>().TypedArrayType() != napi_float64_array ||
+      info[1].As<Napi::TypedArray>().TypedArrayType() != napi_int32_array) {
+    return throwJs(env, "usage: run(items: Float64Array, steps: Int32Array)");
+  }
+
+  Napi::TypedArrayOf<double> items = info[0].As<Napi::TypedArrayOf<double>>();
+  Napi::TypedArrayOf<int32_t> steps =
+      info[1].As<Napi::TypedArrayOf<int32_t>>();
+  if (items.ElementLength() % item_size != 0 ||
+      steps.ElementLength() % step_size != 0) {
+    return throwJs(env, "items or steps has a partial entry");
+  }
+
+  int done =
+      this->runSteps(env, items.Data(), items.ElementLength() / item_size,
+                     steps.Data(), steps.ElementLength() / step_size);
+  if (done < 0) {
+    return env.Null();
+  }
+  return Napi::Number::New(env, done);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include <napi.h>
+
+#include "napi-helpers.hh"
+
+// Native runner for the batches of executions in src/core/exec-batch.ts.
+// It's handed the programs from compiledPrograms() once, and then runs
+// each tick's batch over the item and step tables in place, exactly as
+// runExecBatch does; see there for the table layouts.
+class ExecEngine : public Napi::ObjectWrap<ExecEngine> {
+public:
+  ExecEngine(const Napi::CallbackInfo &info);
+  NFUNC(run);
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+  static Napi::FunctionReference constructor;
+
+  // These have to agree with exec-batch.ts
+  enum Op { op_add_cpu = 1, op_mov_cpu, op_toggle_acl, op_require };
+  enum StepKind { step_start = 0, step_finish = 1 };
+  static const int instr_size = 4;
+  static const int item_size = 3;
+  static const int step_size = 5;
+  static const int max_targets = 2;
+  static const int num_acl_bits = 5;
+  static const int touched_cpu = 1;
+  static const int touched_acl = 2;
+
+private:
+  struct Instr {
+    int op, a, b, c;
+  };
+
+  struct Program {
+    bool compiled;
+    double cpu_cost;
+    int num_targets;
+    std::vector<Instr> code;
+  };
+
+  // Returns the number of steps run, or -1 after throwing if the tables
+  // don't make sense.
+  int runSteps(Napi::Env env, double *items, size_t num_items,
+               const int32_t *steps, size_t num_steps);
+
+  std::vector<Program> _programs;
+};
@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+#include <SDL2/SDL_opengl_glext.h>
+
+#include "frame-capture.hh"
+#include "gl-state.hh"
+
+namespace {
+
+// Enough slots to cover the couple of frames of latency a driver
+// typically runs behind, plus slack.
+const size_t RING_SIZE = 4;
+// Frames waiting for the writer. Each is a full window of rgba, so
+// don't make this big.
+const size_t QUEUE_SIZE = 8;
+
+// Minimal png encoder. The image data is stored with uncompressed
+// deflate blocks, so files are about as big as raw frames, but we
+// don't need to pull in zlib for it.
+
+uint32_t crc_table[256];
+
+void initCrcTable() {
+  for (uint32_t n = 0; n < 256; n++) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; k++) {
+      c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+    }
+    crc_table[n] = c;
+  }
+}
+
+uint32_t crc(const unsigned char *buf, size_t len) {
+  uint32_t c = 0xffffffffu;
+  for (size_t i = 0; i < len; i++) {
+    c = crc_table[(c ^ buf[i]) & 0xff] ^ (c >> 8);
+  }
+  return c ^ 0xffffffffu;
+}
+
+void putBe32(std::vector<unsigned char> &out, uint32_t v) {
+  out.push_back(v >> 24);
+  out.push_back(v >> 16);
+  out.push_back(v >> 8);
+  out.push_back(v);
+}
+
+void putChunk(FILE *f, const char *type,
+              const std::vector<unsigned char> &data) {
+  std::vector<unsigned char> chunk;
+  putBe32(chunk, data.size());
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  putBe32(chunk, crc(chunk.data() + 4, chunk.size() - 4));
+  fwrite(chunk.data(), 1, chunk.size(), f);
+}
+
+// rows are top-to-bottom rgba
+bool writePng(const char *filename, const unsigned char *rows, int width,
+              int height) {
+  FILE *f = fopen(filename, "wb");
+  if (!f) {
+    return false;
+  }
+
+  const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a,
+                                     '\n'};
+  fwrite(signature, 1, sizeof(signature), f);
+
+  std::vector<unsigned char> ihdr;
+  putBe32(ihdr, width);
+  putBe32(ihdr, height);
+  ihdr.push_back(8); // bit depth
+  ihdr.push_back(6); // color type rgba
+  ihdr.push_back(0); // compression
+  ihdr.push_back(0); // filter
+  ihdr.push_back(0); // interlace
+  putChunk(f, "IHDR", ihdr);
+
+  // Scanlines each get a leading filter type byte of 0 (none)
+  const size_t stride = width * 4;
+  std::vector<unsigned char> raw;
+  raw.reserve((stride + 1) * height);
+  for (int y = 0; y < height; y++) {
+    raw.push_back(0);
+    raw.insert(raw.end(), rows + y * stride, rows + (y + 1) * stride);
+  }
+
+  std::vector<unsigned char> idat;
+  idat.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+  idat.push_back(0x78); // zlib header: deflate, no preset dictionary
+  idat.push_back(0x01);
+  uint32_t a = 1, b = 0;
+  size_t pos = 0;
+  do {
+    size_t len = std::min(raw.size() - pos, (size_t)65535);
+    bool final = pos + len == raw.size();
+    idat.push_back(final ? 1 : 0);
+    idat.push_back(len & 0xff);
+    idat.push_back(len >> 8);
+    idat.push_back(~len & 0xff);
+    idat.push_back((~len >> 8) & 0xff);
+    for (size_t i = pos; i < pos + len; i++) {
+      a = (a + raw[i]) % 65521;
+      b = (b + a) % 65521;
+    }
+    idat.insert(idat.end(), raw.begin() + pos, raw.begin() + pos + len);
+    pos += len;
+  } while (pos < raw.size());
+  putBe32(idat, (b << 16) | a);
+  putChunk(f, "IDAT", idat);
+
+  putChunk(f, "IEND", {});
+
+  bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
+
+} // namespace
+
+FrameCapture::FrameCapture(const std::string &path, bool png, int fps,
+                           int width, int height)
+    : _path(path), _png(png), _width(width), _height(height) {
+  if (crc_table[1] == 0) {
+    initCrcTable();
+  }
+
+  this->_interval =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / fps));
+  this->_next_due = std::chrono::steady_clock::now();
+
+  if (!png) {
+    this->_raw_file = fopen(path.c_str(), "wb");
+  }
+
+  const size_t frame_bytes = (size_t)width * height * 4;
+  this->_ring.resize(RING_SIZE);
+  for (Slot &slot : this->_ring) {
+    glGenBuffers(1, &slot.pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, frame_bytes, NULL, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  this->_writer = std::thread(&FrameCapture::writerLoop, this);
+}
+
+FrameCapture::~FrameCapture() {
+  this->harvest(true);
+
+  {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    this->_stopping = true;
+  }
+  this->_cond.notify_one();
+  this->_writer.join();
+
+  for (Slot &slot : this->_ring) {
+    glDeleteBuffers(1, &slot.pbo);
+  }
+  if (this->_raw_file) {
+    fclose(this->_raw_file);
+  }
+}
+
+bool FrameCapture::validPattern(const std::string &path) {
+  // Exactly one conversion, of the form %d or %0Nd
+  size_t pct = path.find('%');
+  if (pct == std::string::npos ||
+      path.find('%', pct + 1) != std::string::npos) {
+    return false;
+  }
+  size_t i = pct + 1;
+  while (i < path.size() && isdigit(path[i])) {
+    i++;
+  }
+  return i < path.size() && path[i] == 'd';
+}
+
+size_t FrameCapture::written() {
+  std::lock_guard<std::mutex> lock(this->_mutex);
+  return this->_written;
+}
+
+void FrameCapture::endFrame() {
+  this->harvest(false);
+
+  auto now = std::chrono::steady_clock::now();
+  if (now < this->_next_due) {
+    return;
+  }
+  this->_next_due += this->_interval;
+  if (this->_next_due < now) {
+    // We fell behind; don't try to catch up with a burst
+    this->_next_due = now + this->_interval;
+  }
+
+  size_t number = this->_captured++;
+  if (this->_ring_used == this->_ring.size()) {
+    this->_dropped++;
+    return;
+  }
+
+  Slot &slot = this->_ring[(this->_ring_head + this->_ring_used) %
+                           this->_ring.size()];
+  this->_ring_used++;
+
+  GlState::bindFramebuffer(0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  glReadPixels(0, 0, this->_width, this->_height, GL_RGBA, GL_UNSIGNED_BYTE,
+               0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.number = number;
+}
+
+void FrameCapture::harvest(bool block) {
+  const size_t frame_bytes = (size_t)this->_width * this->_height * 4;
+  const size_t stride = this->_width * 4;
+
+  while (this->_ring_used > 0) {
+    Slot &slot = this->_ring[this->_ring_head];
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                     block ? GL_TIMEOUT_IGNORED : 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      return;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    Frame frame;
+    frame.number = slot.number;
+    frame.pixels.resize(frame_bytes);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const unsigned char *data = (const unsigned char *)glMapBufferRange(
+        GL_PIXEL_PACK_BUFFER, 0, frame_bytes, GL_MAP_READ_BIT);
+    if (data) {
+      // gl rows go bottom-to-top
+      for (int y = 0; y < this->_height; y++) {
+        memcpy(frame.pixels.data() + y * stride,
+               data + (this->_height - 1 - y) * stride, stride);
+      }
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    this->_ring_head = (this->_ring_head + 1) % this->_ring.size();
+    this->_ring_used--;
+
+    if (data) {
+      this->enqueue(std::move(frame));
+    }
+    else {
+      this->_dropped++;
+    }
+  }
+}
+
+void FrameCapture::enqueue(Frame &&frame) {
+  {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    if (this->_queue.size() >= QUEUE_SIZE) {
+      this->_dropped++;
+      return;
+    }
+    this->_queue.push_back(std::move(frame));
+  }
+  this->_cond.notify_one();
+}
+
+void FrameCapture::writerLoop() {
+  std::unique_lock<std::mutex> lock(this->_mutex);
+  while (true) {
+    this->_cond.wait(lock, [this] {
+      return this->_stopping || !this->_queue.empty();
+    });
+    if (this->_queue.empty()) {
+      return; // stopping, and everything is flushed
+    }
+    Frame frame = std::move(this->_queue.front());
+    this->_queue.pop_front();
+
+    lock.unlock();
+    this->write(frame);
+    lock.lock();
+
+    this->_written++;
+  }
+}
+
+void FrameCapture::write(const Frame &frame) {
+  if (this->_png) {
+    char filename[4096];
+    snprintf(filename, sizeof(filename), this->_path.c_str(),
+             (int)frame.number);
+    if (!writePng(filename, frame.pixels.data(), this->_width,
+                  this->_height)) {
+      printf("frame-capture: couldn't write %s\n", filename);
+    }
+  }
+  else if (this->_raw_file) {
+    fwrite(frame.pixels.data(), 1, frame.pixels.size(), this->_raw_file);
+  }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+
+// Records what's in the back buffer, a few frames behind, without
+// ever waiting on the gpu. Each captured frame is read into one of a
+// ring of pixel buffer objects with a fence behind it; we only map a
+// buffer once its fence has signaled. Mapped frames are handed off to
+// a thread that writes them to disk. If either the ring or the
+// writer's queue is full, the frame is dropped.
+//
+// If path ends in ".png", it's used as a printf pattern for the frame
+// number, e.g. "/tmp/capture-%05d.png". Otherwise every frame is
+// appended to path as raw top-to-bottom rgba, suitable for something
+// like
+//   ffmpeg -f rawvideo -pix_fmt rgba -s WxH -r 30 -i path out.mp4
+// where WxH has to be the frame size, which is the drawable size when
+// the capture started (not the window size, on HiDPI displays), as
+// reported by captureStats.
+class FrameCapture {
+public:
+  FrameCapture(const std::string &path, bool png, int fps, int width,
+               int height);
+  ~FrameCapture();
+
+  // Whether a png path has a usable frame number pattern
+  static bool validPattern(const std::string &path);
+
+  // False if we couldn't open the output file
+  bool ok() { return this->_png || this->_raw_file; }
+
+  // Call after the frame is drawn and before the swap
+  void endFrame();
+
+  size_t captured() { return this->_captured; }
+  size_t dropped() { return this->_dropped; }
+  size_t written();
+  int width() { return this->_width; }
+  int height() { return this->_height; }
+
+private:
+  struct Frame {
+    size_t number;
+    std::vector<unsigned char> pixels;
+  };
+
+  struct Slot {
+    GLuint pbo;
+    GLsync fence = nullptr;
+    size_t number;
+  };
+
+  // Maps and enqueues every slot whose readback has landed. If block,
+  // waits for outstanding fences instead of skipping them.
+  void harvest(bool block);
+  void enqueue(Frame &&frame);
+  void writerLoop();
+  void write(const Frame &frame);
+
+  std::string _path;
+  bool _png;
+  int _width, _height;
+  std::chrono::steady_clock::duration _interval;
+  std::chrono::steady_clock::time_point _next_due;
+
+  std::vector<Slot> _ring;
+  size_t _ring_head = 0; // oldest outstanding readback
+  size_t _ring_used = 0;
+
+  size_t _captured = 0;
+  size_t _dropped = 0;
+
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::deque<Frame> _queue;
+  bool _stopping = false;
+  size_t _written = 0;
+  FILE *_raw_file = nullptr;
+  std::thread _writer;
+};
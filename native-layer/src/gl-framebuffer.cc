@@ -3,6 +3,8 @@
 #include <SDL2/SDL_opengl_glext.h>
 
 #include "gl-framebuffer.hh"
+#include "gl-resources.hh"
+#include "gl-state.hh"
 #include "vendor/stb_image.h"
 
 Napi::FunctionReference GlFramebuffer::constructor;
@@ -32,7 +34,12 @@ GlFramebuffer::GlFramebuffer(const Napi::CallbackInfo &info)
   NBOILER_UNUSED();
 
   glGenFramebuffers(1, &this->_framebuffer);
-  glBindFramebuffer(GL_FRAMEBUFFER, this->_framebuffer);
+  GlState::bindFramebuffer(this->_framebuffer);
+  GlResources::created(kind_framebuffer);
+}
+
+GlFramebuffer::~GlFramebuffer() {
+  GlResources::released(kind_framebuffer, this->_framebuffer, 0);
 }
 
 NFUNC(GlFramebuffer::framebufferId) {
@@ -44,7 +51,10 @@ NFUNC(GlFramebuffer::framebufferId) {
 NFUNC(GlFramebuffer::bind) {
   NBOILER();
 
-  glBindFramebuffer(GL_FRAMEBUFFER, this->_framebuffer);
+  GlState::bindFramebuffer(this->_framebuffer);
+  if (this->_width > 0) {
+    GlState::viewport(0, 0, this->_width, this->_height);
+  }
 
   return env.Null();
 }
@@ -52,7 +62,8 @@ NFUNC(GlFramebuffer::bind) {
 NFUNC(GlFramebuffer::unbind) {
   NBOILER();
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  GlState::bindFramebuffer(0);
+  GlState::useWindowViewport();
 
   return env.Null();
 }
@@ -61,15 +72,31 @@ NFUNC(GlFramebuffer::setOutputTexture) {
   NBOILER();
 
   if (info.Length() < 1) {
-    throwJs(env, "usage: setOutputTexture(texture: number)");
+    return throwJs(env, "usage: setOutputTexture(texture: number, width?: "
+                        "number, height?: number)");
   }
 
   if (!info[0].IsNumber()) {
-    throwJs(env, "argument 0 should be a number");
+    return throwJs(env, "argument 0 should be a number");
+  }
+
+  // The size is optional, but without it bind() can't set the
+  // viewport to match the texture.
+  if (info.Length() >= 3) {
+    if (!info[1].IsNumber()) {
+      return throwJs(env, "argument 1 should be a number");
+    }
+    if (!info[2].IsNumber()) {
+      return throwJs(env, "argument 2 should be a number");
+    }
+    this->_width = info[1].As<Napi::Number>().Int32Value();
+    this->_height = info[2].As<Napi::Number>().Int32Value();
   }
 
   unsigned int texture_id = info[0].As<Napi::Number>().Uint32Value();
 
+  // Leaves this framebuffer bound, like the constructor does
+  GlState::bindFramebuffer(this->_framebuffer);
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
                          texture_id, 0);
 
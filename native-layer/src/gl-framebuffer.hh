@@ -7,6 +7,7 @@
 class GlFramebuffer : public Napi::ObjectWrap<GlFramebuffer> {
 public:
   GlFramebuffer(const Napi::CallbackInfo &info);
+  ~GlFramebuffer();
   NFUNC(framebufferId);
   NFUNC(bind);
   NFUNC(unbind);
@@ -17,4 +18,6 @@ public:
 
 private:
   unsigned int _framebuffer;
+  // Size of the output texture, if we were told it
+  int _width = 0, _height = 0;
 };
@@ -3,6 +3,8 @@
 #include <SDL2/SDL_opengl_glext.h>
 
 #include "gl-program.hh"
+#include "gl-resources.hh"
+#include "gl-state.hh"
 #include "gl-utils.hh"
 
 Napi::FunctionReference GlProgram::constructor;
@@ -46,6 +48,7 @@ GlProgram::GlProgram(const Napi::CallbackInfo &info) : ObjectWrap(info) {
   // Set up vertex shader
   {
     this->_vs = vs = glCreateShader(GL_VERTEX_SHADER);
+    GlResources::created(kind_shader);
     std::string shader = info[0].As<Napi::String>().Utf8Value();
     int length = shader.size();
     const char *cstr = shader.c_str();
@@ -57,12 +60,14 @@ GlProgram::GlProgram(const Napi::CallbackInfo &info) : ObjectWrap(info) {
     if (status == GL_FALSE) {
       printShaderLog(vs);
       throwJs(env, "vertex compilation failed");
+      return;
     }
   }
 
   // Set up fragment shader
   {
     this->_fs = fs = glCreateShader(GL_FRAGMENT_SHADER);
+    GlResources::created(kind_shader);
     std::string shader = info[1].As<Napi::String>().Utf8Value();
     int length = shader.size();
     const char *cstr = shader.c_str();
@@ -74,17 +79,39 @@ GlProgram::GlProgram(const Napi::CallbackInfo &info) : ObjectWrap(info) {
     if (status == GL_FALSE) {
       printShaderLog(fs);
       throwJs(env, "fragment compilation failed");
+      return;
     }
   }
 
   printf("Successfully compiled shaders\n");
 
   this->_program = program = glCreateProgram();
+  GlResources::created(kind_program);
   glAttachShader(program, vs);
   glAttachShader(program, fs);
 
   glLinkProgram(program);
-  glUseProgram(program);
+  GlState::useProgram(program);
+
+  // The linked program doesn't need the shader objects anymore
+  glDetachShader(program, vs);
+  glDetachShader(program, fs);
+  GlResources::released(kind_shader, vs, 0);
+  GlResources::released(kind_shader, fs, 0);
+  this->_vs = this->_fs = 0;
+}
+
+GlProgram::~GlProgram() {
+  // Shaders are only still around if compilation failed
+  if (this->_vs) {
+    GlResources::released(kind_shader, this->_vs, 0);
+  }
+  if (this->_fs) {
+    GlResources::released(kind_shader, this->_fs, 0);
+  }
+  if (this->_program) {
+    GlResources::released(kind_program, this->_program, 0);
+  }
 }
 
 NFUNC(GlProgram::programId) {
@@ -112,7 +139,7 @@ NFUNC(GlProgram::getUniformLocation) {
 NFUNC(GlProgram::use) {
   NBOILER();
 
-  glUseProgram(this->_program);
+  GlState::useProgram(this->_program);
 
   return env.Null();
 }
@@ -7,6 +7,7 @@
 class GlProgram : public Napi::ObjectWrap<GlProgram> {
 public:
   GlProgram(const Napi::CallbackInfo &info);
+  ~GlProgram();
   NFUNC(programId);
   NFUNC(getUniformLocation);
   NFUNC(use);
@@ -15,5 +16,5 @@ public:
   static Napi::FunctionReference constructor;
 
 private:
-  unsigned int _program, _vs, _fs;
+  unsigned int _program = 0, _vs = 0, _fs = 0;
 };
@@ -0,0 +1,167 @@
+#include <vector>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+#include <SDL2/SDL_opengl_glext.h>
+
+#include "gl-resources.hh"
+#include "gl-state.hh"
+#include "gl-texture.hh"
+
+namespace {
+
+const char *kind_names[num_resource_kinds] = {"texture", "framebuffer",
+                                              "program", "shader"};
+
+struct KindStats {
+  size_t count = 0;
+  size_t bytes = 0;
+  size_t created = 0;
+  size_t deleted = 0;
+};
+
+struct PendingDelete {
+  GlResourceKind kind;
+  GLuint name;
+};
+
+KindStats stats[num_resource_kinds];
+std::vector<PendingDelete> pending;
+bool context_lost = false;
+
+std::list<GlTexture *> lru;
+size_t vram_budget = 0; // 0 means unlimited
+size_t evictions = 0;
+size_t reloads = 0;
+
+} // namespace
+
+void GlResources::created(GlResourceKind kind) {
+  stats[kind].count++;
+  stats[kind].created++;
+}
+
+void GlResources::resized(GlResourceKind kind, size_t old_bytes,
+                          size_t new_bytes) {
+  stats[kind].bytes += new_bytes;
+  stats[kind].bytes -= old_bytes;
+}
+
+void GlResources::released(GlResourceKind kind, GLuint name, size_t bytes) {
+  stats[kind].count--;
+  stats[kind].bytes -= bytes;
+  stats[kind].deleted++;
+  if (!context_lost) {
+    pending.push_back({kind, name});
+  }
+}
+
+void GlResources::collect() {
+  for (const PendingDelete &p : pending) {
+    switch (p.kind) {
+    case kind_texture:
+      glDeleteTextures(1, &p.name);
+      GlState::forgetTexture(p.name);
+      break;
+    case kind_framebuffer:
+      glDeleteFramebuffers(1, &p.name);
+      GlState::forgetFramebuffer(p.name);
+      break;
+    case kind_program:
+      glDeleteProgram(p.name);
+      GlState::forgetProgram(p.name);
+      break;
+    case kind_shader:
+      glDeleteShader(p.name);
+      break;
+    default:
+      break;
+    }
+  }
+  pending.clear();
+}
+
+void GlResources::contextLost() {
+  pending.clear();
+  context_lost = true;
+}
+
+std::list<GlTexture *>::iterator
+GlResources::addReloadable(GlTexture *texture) {
+  return lru.insert(lru.end(), texture);
+}
+
+void GlResources::removeReloadable(std::list<GlTexture *>::iterator it) {
+  lru.erase(it);
+}
+
+void GlResources::touch(std::list<GlTexture *>::iterator it) {
+  lru.splice(lru.end(), lru, it);
+}
+
+void GlResources::noteReload() { reloads++; }
+
+void GlResources::enforceBudget(GlTexture *keep) {
+  if (vram_budget == 0) {
+    return;
+  }
+  // Least recently used textures are at the front of the list. A
+  // texture still bound to some unit may be sampled by the next draw,
+  // so we leave it alone even if that means staying over budget.
+  for (GlTexture *texture : lru) {
+    if (stats[kind_texture].bytes <= vram_budget) {
+      break;
+    }
+    if (texture == keep || !texture->resident() ||
+        GlState::isTextureBound(texture->name())) {
+      continue;
+    }
+    texture->evict();
+    evictions++;
+  }
+}
+
+NFUNC(getResourceStats) {
+  NBOILER();
+
+  Napi::Object result = Napi::Object::New(env);
+  for (int i = 0; i < num_resource_kinds; i++) {
+    Napi::Object kind = Napi::Object::New(env);
+    kind.Set("count", Napi::Number::New(env, stats[i].count));
+    kind.Set("bytes", Napi::Number::New(env, stats[i].bytes));
+    kind.Set("created", Napi::Number::New(env, stats[i].created));
+    kind.Set("deleted", Napi::Number::New(env, stats[i].deleted));
+    result.Set(kind_names[i], kind);
+  }
+  result.Set("pendingDeletes", Napi::Number::New(env, pending.size()));
+  result.Set("vramBudget", Napi::Number::New(env, vram_budget));
+  result.Set("evictions", Napi::Number::New(env, evictions));
+  result.Set("reloads", Napi::Number::New(env, reloads));
+
+  return result;
+}
+
+NFUNC(setVramBudget) {
+  NBOILER();
+
+  if (info.Length() < 1) {
+    return throwJs(env, "usage: setVramBudget(bytes: number)");
+  }
+
+  if (!info[0].IsNumber()) {
+    return throwJs(env, "argument 0 should be a number");
+  }
+
+  int64_t bytes = info[0].As<Napi::Number>().Int64Value();
+  vram_budget = bytes > 0 ? bytes : 0;
+  GlResources::enforceBudget(nullptr);
+
+  return env.Null();
+}
+
+Napi::Object GlResources::Init(Napi::Env env, Napi::Object exports) {
+  exports.Set("getResourceStats", Napi::Function::New(env, getResourceStats));
+  exports.Set("setVramBudget", Napi::Function::New(env, setVramBudget));
+
+  return exports;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <list>
+#include <napi.h>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+
+#include "napi-helpers.hh"
+
+class GlTexture;
+
+enum GlResourceKind {
+  kind_texture,
+  kind_framebuffer,
+  kind_program,
+  kind_shader,
+  num_resource_kinds,
+};
+
+// Global bookkeeping for every GL object owned by a javascript
+// wrapper. Wrappers are finalized whenever the garbage collector gets
+// around to it, which may be at a moment when no GL context is
+// current, so their destructors only queue names here; the queue is
+// drained by collect() at a point where we know the context is live.
+class GlResources {
+public:
+  static void created(GlResourceKind kind);
+  static void resized(GlResourceKind kind, size_t old_bytes, size_t new_bytes);
+  static void released(GlResourceKind kind, GLuint name, size_t bytes);
+
+  // Deletes everything queued by released(). Must be called with the
+  // GL context current.
+  static void collect();
+  // Called once the GL context is gone; from then on released names
+  // are simply forgotten.
+  static void contextLost();
+
+  // Textures that can be reloaded from disk participate in an LRU
+  // list which is consulted when we exceed the vram budget.
+  static std::list<GlTexture *>::iterator addReloadable(GlTexture *texture);
+  static void removeReloadable(std::list<GlTexture *>::iterator it);
+  static void touch(std::list<GlTexture *>::iterator it);
+  static void noteReload();
+  static void enforceBudget(GlTexture *keep);
+
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+};
@@ -0,0 +1,220 @@
+#include <vector>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+#include <SDL2/SDL_opengl_glext.h>
+
+#include "gl-state.hh"
+
+namespace {
+
+const char *call_names[num_state_calls] = {
+    "useProgram",  "bindFramebuffer", "bindVertexArray", "activeTexture",
+    "bindTexture", "blend",           "viewport"};
+
+struct CallStats {
+  size_t issued = 0;
+  size_t elided = 0;
+};
+
+struct Shadow {
+  GLuint program = 0;
+  GLuint framebuffer = 0;
+  GLuint vao = 0;
+  unsigned int active_unit = 0;
+  std::vector<GLuint> unit_textures;
+  bool blend = false;
+  GLenum blend_src = GL_ONE;
+  GLenum blend_dst = GL_ZERO;
+  // Real viewport is the initial window size, which we don't know
+  // here, so start out with something that never matches.
+  GLint viewport[4] = {-1, -1, -1, -1};
+};
+
+Shadow shadow;
+CallStats stats[num_state_calls];
+GLsizei window_width = 0, window_height = 0;
+
+// Returns true if the caller should go ahead and issue the call
+bool changed(GlStateCall call, bool differs) {
+  if (differs) {
+    stats[call].issued++;
+  }
+  else {
+    stats[call].elided++;
+  }
+  return differs;
+}
+
+} // namespace
+
+void GlState::useProgram(GLuint program) {
+  if (changed(call_use_program, shadow.program != program)) {
+    glUseProgram(program);
+    shadow.program = program;
+  }
+}
+
+void GlState::bindFramebuffer(GLuint framebuffer) {
+  if (changed(call_bind_framebuffer, shadow.framebuffer != framebuffer)) {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    shadow.framebuffer = framebuffer;
+  }
+}
+
+void GlState::bindVertexArray(GLuint vao) {
+  if (changed(call_bind_vertex_array, shadow.vao != vao)) {
+    glBindVertexArray(vao);
+    shadow.vao = vao;
+  }
+}
+
+void GlState::activeTexture(unsigned int unit) {
+  if (changed(call_active_texture, shadow.active_unit != unit)) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    shadow.active_unit = unit;
+  }
+}
+
+void GlState::bindTexture(GLuint texture) {
+  std::vector<GLuint> &units = shadow.unit_textures;
+  if (units.size() <= shadow.active_unit) {
+    units.resize(shadow.active_unit + 1, 0);
+  }
+  if (changed(call_bind_texture, units[shadow.active_unit] != texture)) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    units[shadow.active_unit] = texture;
+  }
+}
+
+void GlState::bindTextureUnit(unsigned int unit, GLuint texture) {
+  // Check first so that a redundant bind doesn't even switch units
+  if (unit < shadow.unit_textures.size() &&
+      shadow.unit_textures[unit] == texture) {
+    stats[call_bind_texture].elided++;
+    return;
+  }
+  activeTexture(unit);
+  bindTexture(texture);
+}
+
+void GlState::enableBlend(bool enabled) {
+  if (changed(call_blend, shadow.blend != enabled)) {
+    if (enabled) {
+      glEnable(GL_BLEND);
+    }
+    else {
+      glDisable(GL_BLEND);
+    }
+    shadow.blend = enabled;
+  }
+}
+
+void GlState::blendFunc(GLenum sfactor, GLenum dfactor) {
+  if (changed(call_blend,
+              shadow.blend_src != sfactor || shadow.blend_dst != dfactor)) {
+    glBlendFunc(sfactor, dfactor);
+    shadow.blend_src = sfactor;
+    shadow.blend_dst = dfactor;
+  }
+}
+
+void GlState::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+  GLint *v = shadow.viewport;
+  if (changed(call_viewport,
+              v[0] != x || v[1] != y || v[2] != width || v[3] != height)) {
+    glViewport(x, y, width, height);
+    v[0] = x;
+    v[1] = y;
+    v[2] = width;
+    v[3] = height;
+  }
+}
+
+void GlState::setWindowViewport(GLsizei width, GLsizei height) {
+  window_width = width;
+  window_height = height;
+}
+
+void GlState::useWindowViewport() {
+  viewport(0, 0, window_width, window_height);
+}
+
+unsigned int GlState::activeUnit() { return shadow.active_unit; }
+
+GLuint GlState::boundTexture() {
+  const std::vector<GLuint> &units = shadow.unit_textures;
+  return shadow.active_unit < units.size() ? units[shadow.active_unit] : 0;
+}
+
+bool GlState::isTextureBound(GLuint texture) {
+  for (GLuint bound : shadow.unit_textures) {
+    if (bound == texture) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void GlState::forgetTexture(GLuint texture) {
+  for (GLuint &bound : shadow.unit_textures) {
+    if (bound == texture) {
+      bound = 0;
+    }
+  }
+}
+
+void GlState::forgetFramebuffer(GLuint framebuffer) {
+  if (shadow.framebuffer == framebuffer) {
+    shadow.framebuffer = 0;
+  }
+}
+
+void GlState::forgetProgram(GLuint program) {
+  // A deleted program stays in use until something else is made
+  // current, so the shadow is still accurate; but the name may be
+  // recycled, and we must not elide a call using the new object.
+  if (shadow.program == program) {
+    glUseProgram(0);
+    shadow.program = 0;
+  }
+}
+
+void GlState::reset() { shadow = Shadow(); }
+
+NFUNC(getGlStateStats) {
+  NBOILER();
+
+  Napi::Object result = Napi::Object::New(env);
+  size_t issued = 0, elided = 0;
+  for (int i = 0; i < num_state_calls; i++) {
+    Napi::Object call = Napi::Object::New(env);
+    call.Set("issued", Napi::Number::New(env, stats[i].issued));
+    call.Set("elided", Napi::Number::New(env, stats[i].elided));
+    result.Set(call_names[i], call);
+    issued += stats[i].issued;
+    elided += stats[i].elided;
+  }
+  result.Set("issued", Napi::Number::New(env, issued));
+  result.Set("elided", Napi::Number::New(env, elided));
+
+  return result;
+}
+
+NFUNC(resetGlStateStats) {
+  NBOILER();
+
+  for (int i = 0; i < num_state_calls; i++) {
+    stats[i] = CallStats();
+  }
+
+  return env.Null();
+}
+
+Napi::Object GlState::Init(Napi::Env env, Napi::Object exports) {
+  exports.Set("getGlStateStats", Napi::Function::New(env, getGlStateStats));
+  exports.Set("resetGlStateStats",
+              Napi::Function::New(env, resetGlStateStats));
+
+  return exports;
+}
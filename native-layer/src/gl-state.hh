@@ -0,0 +1,54 @@
+#pragma once
+
+#include <napi.h>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+
+#include "napi-helpers.hh"
+
+enum GlStateCall {
+  call_use_program,
+  call_bind_framebuffer,
+  call_bind_vertex_array,
+  call_active_texture,
+  call_bind_texture,
+  call_blend,
+  call_viewport,
+  num_state_calls,
+};
+
+// Shadow copy of the bits of GL state we touch. Every change to this
+// state should go through here so that the shadow stays in sync with
+// the driver; calls that wouldn't change anything are skipped.
+class GlState {
+public:
+  static void useProgram(GLuint program);
+  static void bindFramebuffer(GLuint framebuffer);
+  static void bindVertexArray(GLuint vao);
+  static void activeTexture(unsigned int unit);
+  // Binds to GL_TEXTURE_2D on the active unit
+  static void bindTexture(GLuint texture);
+  static void bindTextureUnit(unsigned int unit, GLuint texture);
+  static void enableBlend(bool enabled);
+  static void blendFunc(GLenum sfactor, GLenum dfactor);
+  static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+  // The viewport to use when drawing to the window, in drawable
+  // (i.e. physical) pixels.
+  static void setWindowViewport(GLsizei width, GLsizei height);
+  static void useWindowViewport();
+
+  static unsigned int activeUnit();
+  static GLuint boundTexture();
+  static bool isTextureBound(GLuint texture);
+
+  // Called after the named object has been deleted, since GL
+  // implicitly unbinds deleted objects.
+  static void forgetTexture(GLuint texture);
+  static void forgetFramebuffer(GLuint framebuffer);
+  static void forgetProgram(GLuint program);
+  // Called when the context goes away
+  static void reset();
+
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+};
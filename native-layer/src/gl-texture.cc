@@ -2,6 +2,7 @@
 #include <SDL2/SDL_opengl.h>
 #include <SDL2/SDL_opengl_glext.h>
 
+#include "gl-state.hh"
 #include "gl-texture.hh"
 #include "vendor/stb_image.h"
 
@@ -15,6 +16,7 @@ Napi::Object GlTexture::Init(Napi::Env env, Napi::Object exports) {
           GlTexture::InstanceMethod("bind", &GlTexture::bind),
           GlTexture::InstanceMethod("loadFile", &GlTexture::loadFile),
           GlTexture::InstanceMethod("makeBlank", &GlTexture::makeBlank),
+          GlTexture::InstanceMethod("setPixels", &GlTexture::setPixels),
       });
 
   GlTexture::constructor = Napi::Persistent(func);
@@ -27,38 +29,88 @@ Napi::Object GlTexture::Init(Napi::Env env, Napi::Object exports) {
 
 GlTexture::GlTexture(const Napi::CallbackInfo &info) : ObjectWrap(info) {
   glGenTextures(1, &this->_texture);
-  glActiveTexture(GL_TEXTURE0);
+  GlResources::created(kind_texture);
+}
+
+GlTexture::~GlTexture() {
+  this->setReloadable(false);
+  GlResources::released(kind_texture, this->_texture, this->_bytes);
+}
+
+void GlTexture::setBytes(size_t bytes) {
+  GlResources::resized(kind_texture, this->_bytes, bytes);
+  this->_bytes = bytes;
+}
+
+void GlTexture::setReloadable(bool reloadable) {
+  if (reloadable == this->_reloadable) {
+    return;
+  }
+  if (reloadable) {
+    this->_lru = GlResources::addReloadable(this);
+  }
+  else {
+    GlResources::removeReloadable(this->_lru);
+  }
+  this->_reloadable = reloadable;
+}
+
+// Uploads go through whatever unit is active, and put back what was
+// bound there afterwards, so that loading a texture never disturbs
+// bindings that javascript set up.
+bool GlTexture::upload(const std::string &filename) {
+  int width, height, nrChannels;
+  unsigned char *data =
+      stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
+  if (!data) {
+    return false;
+  }
+  GLuint prev = GlState::boundTexture();
+  GlState::bindTexture(this->_texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, data);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  GlState::bindTexture(prev);
+  stbi_image_free(data);
+
+  this->setBytes((size_t)width * height * 4);
+  this->_resident = true;
+  return true;
+}
+
+void GlTexture::evict() {
+  GLuint prev = GlState::boundTexture();
+  GlState::bindTexture(this->_texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               NULL);
+  GlState::bindTexture(prev);
+
+  this->setBytes(0);
+  this->_resident = false;
 }
 
 NFUNC(GlTexture::loadFile) {
   NBOILER();
 
-  glBindTexture(GL_TEXTURE_2D, this->_texture);
-
   // XXX Maybe I should move argument checking into a js wrapper?
   if (info.Length() < 1) {
-    throwJs(env, "expected 1 argument");
+    return throwJs(env, "expected 1 argument");
   }
 
   if (!info[0].IsString()) {
-    throwJs(env, "argument 0 should be a string");
+    return throwJs(env, "argument 0 should be a string");
   }
 
   std::string filename = info[0].As<Napi::String>().Utf8Value();
 
-  int width, height, nrChannels;
-  unsigned char *data =
-      stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
-  if (data) {
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-                 GL_UNSIGNED_BYTE, data);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  }
-  else {
-    throwJs(env, "Failed to load texture");
+  if (!this->upload(filename)) {
+    return throwJs(env, "Failed to load texture");
   }
-  stbi_image_free(data);
+  this->_filename = filename;
+  this->setReloadable(true);
+  GlResources::touch(this->_lru);
+  GlResources::enforceBudget(this);
 
   return env.Null();
 }
@@ -66,30 +118,77 @@ NFUNC(GlTexture::loadFile) {
 NFUNC(GlTexture::makeBlank) {
   NBOILER();
 
-  glBindTexture(GL_TEXTURE_2D, this->_texture);
-
   // XXX Maybe I should move argument checking into a js wrapper?
   if (info.Length() < 2) {
-    throwJs(env, "expected 2 arguments");
+    return throwJs(env, "expected 2 arguments");
   }
 
   if (!info[0].IsNumber()) {
-    throwJs(env, "argument 0 should be a number");
+    return throwJs(env, "argument 0 should be a number");
   }
 
   if (!info[1].IsNumber()) {
-    throwJs(env, "argument 1 should be a number");
+    return throwJs(env, "argument 1 should be a number");
   }
 
   int width = info[0].As<Napi::Number>().Uint32Value();
   int height = info[1].As<Napi::Number>().Uint32Value();
 
+  GLuint prev = GlState::boundTexture();
+  GlState::bindTexture(this->_texture);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
                GL_UNSIGNED_BYTE, NULL);
   // interpolation settings unnecessarily coupled to the loaded vs.
   // uninitialized texture distinction
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  GlState::bindTexture(prev);
+
+  // Blank textures are render targets, which we can't reconstruct, so
+  // they are never evicted.
+  this->_filename.clear();
+  this->setReloadable(false);
+  this->setBytes((size_t)width * height * 4);
+  this->_resident = true;
+  GlResources::enforceBudget(this);
+
+  return env.Null();
+}
+
+// setPixels(width: number, height: number, data: Uint8Array): void
+NFUNC(GlTexture::setPixels) {
+  NBOILER();
+
+  if (info.Length() < 3 || !info[0].IsNumber() || !info[1].IsNumber() ||
+      !info[2].IsTypedArray() ||
+      info[2].As<Napi::TypedArray>().TypedArrayType() != napi_uint8_array) {
+    return throwJs(env, "usage: setPixels(width: number, height: number, "
+                        "data: Uint8Array)");
+  }
+
+  int width = info[0].As<Napi::Number>().Uint32Value();
+  int height = info[1].As<Napi::Number>().Uint32Value();
+  Napi::TypedArrayOf<uint8_t> data = info[2].As<Napi::TypedArrayOf<uint8_t>>();
+  size_t bytes = (size_t)width * height * 4;
+  if (data.ElementLength() < bytes) {
+    return throwJs(env, "data is smaller than width * height * 4");
+  }
+
+  GLuint prev = GlState::boundTexture();
+  GlState::bindTexture(this->_texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, data.Data());
+  GlState::bindTexture(prev);
+
+  // Like blank textures, these can't be reconstructed
+  this->_filename.clear();
+  this->setReloadable(false);
+  this->_resident = true;
+  // This is usually the text page, every frame at the same size
+  if (bytes != this->_bytes) {
+    this->setBytes(bytes);
+    GlResources::enforceBudget(this);
+  }
 
   return env.Null();
 }
@@ -110,8 +209,19 @@ NFUNC(GlTexture::bind) {
     return throwJs(env, "argument 0 should be a number");
   }
 
-  glActiveTexture(GL_TEXTURE0 + info[0].As<Napi::Number>().Uint32Value());
-  glBindTexture(GL_TEXTURE_2D, this->_texture);
+  if (this->_reloadable) {
+    if (!this->_resident) {
+      if (!this->upload(this->_filename)) {
+        return throwJs(env, "Failed to reload texture");
+      }
+      GlResources::noteReload();
+    }
+    GlResources::touch(this->_lru);
+    GlResources::enforceBudget(this);
+  }
+
+  GlState::bindTextureUnit(info[0].As<Napi::Number>().Uint32Value(),
+                           this->_texture);
 
   return env.Null();
 }
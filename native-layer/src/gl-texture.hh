@@ -1,20 +1,40 @@
 #pragma once
 
+#include <list>
 #include <napi.h>
 
+#include "gl-resources.hh"
 #include "napi-helpers.hh"
 
 class GlTexture : public Napi::ObjectWrap<GlTexture> {
 public:
   GlTexture(const Napi::CallbackInfo &info);
+  ~GlTexture();
   NFUNC(textureId);
   NFUNC(bind);
   NFUNC(loadFile);
   NFUNC(makeBlank);
+  NFUNC(setPixels);
   static Napi::Object Init(Napi::Env env, Napi::Object exports);
 
   static Napi::FunctionReference constructor;
 
+  GLuint name() { return this->_texture; }
+  bool resident() { return this->_resident; }
+  // Drop the storage of a file-backed texture, keeping its name so
+  // that ids held by javascript stay valid. The next bind reloads it.
+  void evict();
+
 private:
+  bool upload(const std::string &filename);
+  void setBytes(size_t bytes);
+  void setReloadable(bool reloadable);
+
   unsigned int _texture;
+  size_t _bytes = 0;
+  bool _resident = true;
+  // Nonempty iff the texture was last filled by loadFile
+  std::string _filename;
+  bool _reloadable = false;
+  std::list<GlTexture *>::iterator _lru;
 };
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <math.h>
+#include <memory>
 #include <napi.h>
 
 #include <SDL2/SDL.h>
@@ -7,11 +8,20 @@
 #include <SDL2/SDL_opengl.h>
 #include <SDL2/SDL_opengl_glext.h>
 
+#include "event-log.hh"
+#include "exec-engine.hh"
+#include "frame-capture.hh"
 #include "gl-framebuffer.hh"
 #include "gl-program.hh"
+#include "gl-resources.hh"
+#include "gl-state.hh"
 #include "gl-texture.hh"
 #include "napi-helpers.hh"
 #include "sample.hh"
+#include "shader-variants.hh"
+#include "stream.hh"
+#include "tag-layout.hh"
+#include "virtual-gen.hh"
 #include "vendor/stb_image.h"
 
 typedef enum t_attrib_id { attrib_uv } t_attrib_id;
@@ -25,6 +35,13 @@ public:
   Napi::Value drawTriangles(const Napi::CallbackInfo &);
   Napi::Value clear(const Napi::CallbackInfo &);
   Napi::Value swapWindow(const Napi::CallbackInfo &);
+  Napi::Value startCapture(const Napi::CallbackInfo &);
+  Napi::Value stopCapture(const Napi::CallbackInfo &);
+  Napi::Value captureStats(const Napi::CallbackInfo &);
+  Napi::Value startRecording(const Napi::CallbackInfo &);
+  Napi::Value stopRecording(const Napi::CallbackInfo &);
+  Napi::Value windowSize(const Napi::CallbackInfo &);
+  Napi::Value pollResize(const Napi::CallbackInfo &);
 
   Napi::Value hello(Napi::Env);
   static Napi::Object Init(Napi::Env env, Napi::Object exports);
@@ -37,10 +54,19 @@ public:
   static Napi::FunctionReference constructor;
 
 private:
+  Napi::Value sizeObject(Napi::Env env);
+  void updateDrawableSize();
+
+  // Window size in screen coordinates, and in pixels. These differ on
+  // HiDPI displays.
   int _width, _height;
+  int _drawable_width, _drawable_height;
+  bool _resized = false;
   SDL_Window *_window;
   SDL_GLContext _context;
-  GLuint _vao, _vbo;
+  GLuint _vao = 0, _vbo = 0;
+  std::unique_ptr<FrameCapture> _capture;
+  std::unique_ptr<EventRecorder> _recorder;
 };
 
 Napi::FunctionReference NativeLayer::constructor;
@@ -86,13 +112,22 @@ NativeLayer::NativeLayer(const Napi::CallbackInfo &info) : ObjectWrap(info) {
 
   SDL_Window *window = SDL_CreateWindow(
       "", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, this->_width,
-      this->_height, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
+      this->_height,
+      SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE |
+          SDL_WINDOW_ALLOW_HIGHDPI);
   SDL_GLContext context = SDL_GL_CreateContext(window);
 
   printf("GL VERSION [%s]\n", glGetString(GL_VERSION));
 
   this->_context = context;
   this->_window = window;
+  this->updateDrawableSize();
+}
+
+void NativeLayer::updateDrawableSize() {
+  SDL_GL_GetDrawableSize(this->_window, &this->_drawable_width,
+                         &this->_drawable_height);
+  GlState::setWindowViewport(this->_drawable_width, this->_drawable_height);
 }
 
 Napi::Value NativeLayer::configShaders(const Napi::CallbackInfo &info) {
@@ -113,34 +148,37 @@ Napi::Value NativeLayer::configShaders(const Napi::CallbackInfo &info) {
   glDisable(GL_DEPTH_TEST);
   // #877a6a
   glClearColor(0x87 / 255., 0x7a / 255., 0x6a / 255., 1.);
-  glViewport(0, 0, this->_width, this->_height);
-
-  glGenVertexArrays(1, &this->_vao);
-  glGenBuffers(1, &this->_vbo);
-  glBindVertexArray(this->_vao);
-  glBindBuffer(GL_ARRAY_BUFFER, this->_vbo);
-
-  glEnableVertexAttribArray(attrib_uv);
-
-  glVertexAttribPointer(attrib_uv, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2,
-                        (void *)(0 * sizeof(float)));
-
-  // comments prevent clang-format from wrapping while preserving
-  // alignment
-  const GLfloat g_vertex_buffer_data[] = {
-      0, 0, //
-      1, 0, //
-      1, 1, //
-      0, 0, //
-      1, 1, //
-      0, 1  //
-  };
-
-  glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data),
-               g_vertex_buffer_data, GL_STATIC_DRAW);
+  GlState::useWindowViewport();
+
+  // Every program shares the same quad, so only build it once
+  if (this->_vao == 0) {
+    glGenVertexArrays(1, &this->_vao);
+    glGenBuffers(1, &this->_vbo);
+    GlState::bindVertexArray(this->_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, this->_vbo);
+
+    glEnableVertexAttribArray(attrib_uv);
+
+    glVertexAttribPointer(attrib_uv, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2,
+                          (void *)(0 * sizeof(float)));
+
+    // comments prevent clang-format from wrapping while preserving
+    // alignment
+    const GLfloat g_vertex_buffer_data[] = {
+        0, 0, //
+        1, 0, //
+        1, 1, //
+        0, 0, //
+        1, 1, //
+        0, 1  //
+    };
+
+    glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data),
+                 g_vertex_buffer_data, GL_STATIC_DRAW);
+  }
 
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glEnable(GL_BLEND);
+  GlState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  GlState::enableBlend(true);
 
   return env.Null();
 }
@@ -154,8 +192,32 @@ Napi::Value NativeLayer::pollEvent(const Napi::CallbackInfo &info) {
   while (SDL_PollEvent(&event)) {
     switch (event.type) {
     case SDL_KEYDOWN:
+      if (this->_recorder) {
+        this->_recorder->record(EVENT_KEYDOWN, event.key.keysym.sym);
+      }
       return Napi::String::New(env, SDL_GetKeyName(event.key.keysym.sym));
       break;
+    case SDL_WINDOWEVENT:
+      // This also covers moving to a display with a different pixel
+      // density, which changes the drawable size but not the window
+      // size.
+      if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+        this->_width = event.window.data1;
+        this->_height = event.window.data2;
+        this->updateDrawableSize();
+        GlState::useWindowViewport();
+        this->_resized = true;
+        // Frames are all the size the capture started at, so it can't
+        // carry on at a new one.
+        if (this->_capture &&
+            (this->_capture->width() != this->_drawable_width ||
+             this->_capture->height() != this->_drawable_height)) {
+          printf("frame-capture: stopped, drawable resized to %dx%d\n",
+                 this->_drawable_width, this->_drawable_height);
+          this->_capture.reset();
+        }
+      }
+      break;
     }
   }
   return env.Null();
@@ -171,7 +233,7 @@ Napi::Value NativeLayer::clear(const Napi::CallbackInfo &info) {
 
 Napi::Value NativeLayer::drawTriangles(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
-  glBindVertexArray(this->_vao);
+  GlState::bindVertexArray(this->_vao);
   glDrawArrays(GL_TRIANGLES, 0, 6);
 
   return env.Null();
@@ -180,22 +242,168 @@ Napi::Value NativeLayer::drawTriangles(const Napi::CallbackInfo &info) {
 Napi::Value NativeLayer::swapWindow(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
+  if (this->_capture) {
+    this->_capture->endFrame();
+  }
+
   SDL_GL_SwapWindow(this->_window);
   //  SDL_Delay(1);
 
+  // End of frame is a good time to delete whatever got garbage
+  // collected during it.
+  GlResources::collect();
+
   return env.Null();
 }
 
 Napi::Value NativeLayer::finish(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
 
+  this->_capture.reset();
+  this->_recorder.reset();
+  GlResources::collect();
+  glDeleteBuffers(1, &this->_vbo);
+  glDeleteVertexArrays(1, &this->_vao);
   SDL_GL_DeleteContext(this->_context);
+  GlResources::contextLost();
+  GlState::reset();
   SDL_DestroyWindow(this->_window);
+  Stream::closeAll();
   SDL_Quit();
 
   return env.Null();
 }
 
+Napi::Value NativeLayer::startCapture(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 2) {
+    return throwJs(env, "usage: startCapture(path: string, fps: number)");
+  }
+
+  if (!info[0].IsString()) {
+    return throwJs(env, "argument 0 should be a string");
+  }
+
+  if (!info[1].IsNumber()) {
+    return throwJs(env, "argument 1 should be a number");
+  }
+
+  std::string path = info[0].As<Napi::String>().Utf8Value();
+  int fps = info[1].As<Napi::Number>().Int32Value();
+
+  if (fps <= 0) {
+    return throwJs(env, "fps should be positive");
+  }
+
+  const std::string ext = ".png";
+  bool png = path.size() >= ext.size() &&
+             path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+  if (png && !FrameCapture::validPattern(path)) {
+    return throwJs(env, "png capture path needs a frame number pattern, "
+                        "like capture-%05d.png");
+  }
+
+  // Finish any capture already in progress
+  this->_capture.reset();
+
+  int width, height;
+  SDL_GL_GetDrawableSize(this->_window, &width, &height);
+  this->_capture.reset(new FrameCapture(path, png, fps, width, height));
+  if (!this->_capture->ok()) {
+    this->_capture.reset();
+    return throwJs(env, "couldn't open capture file");
+  }
+
+  return env.Null();
+}
+
+Napi::Value NativeLayer::stopCapture(const Napi::CallbackInfo &info) {
+  Napi::Value stats = this->captureStats(info);
+  // Blocks until every pending frame has been written
+  this->_capture.reset();
+
+  return stats;
+}
+
+Napi::Value NativeLayer::captureStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (!this->_capture) {
+    return env.Null();
+  }
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("captured", Napi::Number::New(env, this->_capture->captured()));
+  result.Set("dropped", Napi::Number::New(env, this->_capture->dropped()));
+  result.Set("written", Napi::Number::New(env, this->_capture->written()));
+  result.Set("width", Napi::Number::New(env, this->_capture->width()));
+  result.Set("height", Napi::Number::New(env, this->_capture->height()));
+
+  return result;
+}
+
+Napi::Value NativeLayer::startRecording(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1) {
+    return throwJs(env, "usage: startRecording(path: string)");
+  }
+
+  if (!info[0].IsString()) {
+    return throwJs(env, "argument 0 should be a string");
+  }
+
+  std::string path = info[0].As<Napi::String>().Utf8Value();
+  this->_recorder.reset(new EventRecorder(path));
+  if (!this->_recorder->ok()) {
+    this->_recorder.reset();
+    return throwJs(env, "couldn't open event log " + path);
+  }
+
+  return env.Null();
+}
+
+// Returns how many events were recorded
+Napi::Value NativeLayer::stopRecording(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (!this->_recorder) {
+    return env.Null();
+  }
+  size_t count = this->_recorder->count();
+  this->_recorder.reset();
+
+  return Napi::Number::New(env, count);
+}
+
+Napi::Value NativeLayer::sizeObject(Napi::Env env) {
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("width", Napi::Number::New(env, this->_width));
+  result.Set("height", Napi::Number::New(env, this->_height));
+  result.Set("drawableWidth", Napi::Number::New(env, this->_drawable_width));
+  result.Set("drawableHeight",
+             Napi::Number::New(env, this->_drawable_height));
+  return result;
+}
+
+Napi::Value NativeLayer::windowSize(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  return this->sizeObject(env);
+}
+
+// Returns the new size if the window has been resized since the last
+// call, null otherwise.
+Napi::Value NativeLayer::pollResize(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  if (!this->_resized) {
+    return env.Null();
+  }
+  this->_resized = false;
+  return this->sizeObject(env);
+}
+
 Napi::Object NativeLayer::Init(Napi::Env env, Napi::Object exports) {
   Napi::Function func = DefineClass(
       env, "NativeLayer",
@@ -208,6 +416,18 @@ Napi::Object NativeLayer::Init(Napi::Env env, Napi::Object exports) {
                                       &NativeLayer::drawTriangles),
           NativeLayer::InstanceMethod("clear", &NativeLayer::clear),
           NativeLayer::InstanceMethod("swapWindow", &NativeLayer::swapWindow),
+          NativeLayer::InstanceMethod("startCapture",
+                                      &NativeLayer::startCapture),
+          NativeLayer::InstanceMethod("stopCapture",
+                                      &NativeLayer::stopCapture),
+          NativeLayer::InstanceMethod("captureStats",
+                                      &NativeLayer::captureStats),
+          NativeLayer::InstanceMethod("startRecording",
+                                      &NativeLayer::startRecording),
+          NativeLayer::InstanceMethod("stopRecording",
+                                      &NativeLayer::stopRecording),
+          NativeLayer::InstanceMethod("windowSize", &NativeLayer::windowSize),
+          NativeLayer::InstanceMethod("pollResize", &NativeLayer::pollResize),
       });
 
   NativeLayer::constructor = Napi::Persistent(func);
@@ -302,7 +522,7 @@ NFUNC(wrap_glActiveTexture) {
 
   unsigned int texture_unit = info[0].As<Napi::Number>().Uint32Value();
 
-  glActiveTexture(GL_TEXTURE0 + texture_unit);
+  GlState::activeTexture(texture_unit);
 
   return env.Null();
 }
@@ -323,19 +543,6 @@ NFUNC(wrap_glUniform4fv) {
   return env.Null();
 }
 
-NFUNC(wrap_glTexImage2d) {
-  NBOILER();
-
-  const unsigned int width = info[0].As<Napi::Number>().Uint32Value();
-  const unsigned int height = info[1].As<Napi::Number>().Uint32Value();
-  const uint8_t *data = info[2].As<Napi::TypedArrayOf<uint8_t>>().Data();
-
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-               GL_UNSIGNED_BYTE, data);
-
-  return env.Null();
-}
-
 // !!!!!!!!!!!!! END UNSAFE
 
 // Sound stuff
@@ -343,7 +550,6 @@ const int BUF_LEN = 2000;
 int *sine_buffer;
 Mix_Chunk *sine;
 
-#define WAVE "/tmp/a.wav"
 NFUNC(playSound) {
   NBOILER();
 
@@ -368,9 +574,9 @@ NFUNC(initSound) {
   }
   sine = Mix_QuickLoad_RAW((Uint8 *)sine_buffer, BUF_LEN * 4);
   if (!sine) {
-    printf(".WAV sound '%s' could not be loaded!\n"
+    printf("sound could not be loaded!\n"
            "SDL_Error: %s\n",
-           WAVE, SDL_GetError());
+           SDL_GetError());
     return throwJs(env, "couldn't init sound");
   }
   return env.Null();
@@ -381,7 +587,15 @@ Napi::Object Init(Napi::Env env, Napi::Object exports) {
   GlTexture::Init(env, exports);
   GlFramebuffer::Init(env, exports);
   GlProgram::Init(env, exports);
+  GlResources::Init(env, exports);
+  GlState::Init(env, exports);
+  ShaderVariants::Init(env, exports);
+  EventReplay::Init(env, exports);
+  ExecEngine::Init(env, exports);
   Sample::Init(env, exports);
+  Stream::Init(env, exports);
+  TagLayout::Init(env, exports);
+  VirtualGen::Init(env, exports);
 
   exports.Set("glUniform1i", Napi::Function::New(env, wrap_glUniform1i));
   exports.Set("glUniform1f", Napi::Function::New(env, wrap_glUniform1f));
@@ -390,7 +604,6 @@ Napi::Object Init(Napi::Env env, Napi::Object exports) {
               Napi::Function::New(env, wrap_glActiveTexture));
 
   exports.Set("_glUniform4fv", Napi::Function::New(env, wrap_glUniform4fv));
-  exports.Set("_glTexImage2d", Napi::Function::New(env, wrap_glTexImage2d));
   exports.Set("playSound", Napi::Function::New(env, playSound));
   exports.Set("initSound", Napi::Function::New(env, initSound));
   return exports;
@@ -0,0 +1,46 @@
+#include <string>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_opengl.h>
+#include <SDL2/SDL_opengl_glext.h>
+
+#include "gen/config.h"
+#include "gen/shaders.h"
+#include "shader-variants.hh"
+
+static_assert(config::TEXT_PAGE_W >= config::COLS &&
+                  config::TEXT_PAGE_H >= config::ROWS,
+              "text page should hold the whole grid");
+static_assert(sizeof(config::palette) == 16 * 4 * sizeof(GLfloat),
+              "palette should have 16 rgba entries");
+
+// getShaderVariant(name: string, configHash: string): string | null
+NFUNC(getShaderVariant) {
+  NBOILER();
+
+  if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString()) {
+    return throwJs(env, "usage: getShaderVariant(name: string, "
+                        "configHash: string)");
+  }
+
+  std::string name = info[0].As<Napi::String>().Utf8Value();
+  std::string hash = info[1].As<Napi::String>().Utf8Value();
+  if (hash != config::HASH) {
+    return throwJs(env, "native-layer was built for config " +
+                            std::string(config::HASH) + ", not " + hash +
+                            "; rerun make and rebuild it");
+  }
+
+  for (const ShaderVariant &variant : shader_variants) {
+    if (name == variant.name) {
+      return Napi::String::New(env, variant.source);
+    }
+  }
+  return env.Null();
+}
+
+Napi::Object ShaderVariants::Init(Napi::Env env, Napi::Object exports) {
+  exports.Set("getShaderVariant", Napi::Function::New(env, getShaderVariant));
+
+  return exports;
+}
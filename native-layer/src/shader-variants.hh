@@ -0,0 +1,15 @@
+#pragma once
+
+#include <napi.h>
+
+#include "napi-helpers.hh"
+
+// Shaders specialized at build time to the ui constants and palette,
+// generated by src/ui/gen-native.ts. A variant is only handed out if
+// the config it was generated for matches the one the caller is
+// running with, so a stale build falls back to the generic shader
+// rather than drawing a wrong grid.
+class ShaderVariants {
+public:
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+};
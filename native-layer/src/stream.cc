@@ -0,0 +1,643 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "stream.hh"
+
+namespace {
+
+// Samples, not frames; a power of two so indices can just be masked.
+// 64k of 16-bit samples is 128k of memory per stream, or about 1.5s of
+// mono at 44.1kHz.
+const size_t RING_SIZE = 1 << 16;
+const size_t RING_MASK = RING_SIZE - 1;
+// Source frames decoded at a time
+const size_t CHUNK_FRAMES = 4096;
+// How long the decoder sleeps when the ring is full. Should be well
+// under the ring's length in time.
+const auto DECODER_POLL = std::chrono::milliseconds(10);
+
+// SDL_mixer opens its device with SDL_OpenAudioDevice and doesn't tell
+// us the id, so SDL_LockAudio wouldn't keep the callback out. Instead
+// the callback reads an immutable copy of streams, which is replaced
+// whenever streams changes. The old copy is freed once no callback
+// can still be using it. streams itself is only touched from js.
+std::vector<Stream *> streams;
+std::atomic<const std::vector<Stream *> *> mixing_streams{nullptr};
+std::atomic<int> mixing{0}; // callbacks running
+bool hooked = false;
+
+void publishStreams() {
+  const std::vector<Stream *> *prev =
+      mixing_streams.exchange(new std::vector<Stream *>(streams));
+  // A callback that started before the exchange may have prev
+  while (mixing.load() > 0) {
+    std::this_thread::yield();
+  }
+  delete prev;
+}
+
+uint16_t le16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+
+uint32_t le32(const unsigned char *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Most source frames we can decode at once and still fit what they
+// resample to into space samples. step is source frames per output
+// frame; the +2 covers rounding and the frame kept over from the last
+// chunk.
+size_t framesFitting(uint64_t space, double step, int channels) {
+  int64_t out_frames = (int64_t)(space / channels) - 2;
+  if (out_frames <= 0) {
+    return 0;
+  }
+  return std::min((double)CHUNK_FRAMES, std::floor(out_frames * step));
+}
+
+} // namespace
+
+struct WavFile {
+  enum Encoding { pcm, ieee_float };
+
+  FILE *f = nullptr;
+  Encoding encoding;
+  int channels;
+  int rate;
+  int bytes_per_sample;
+  long data_offset;
+  uint64_t frames;
+  uint64_t frame = 0; // next to read
+
+  ~WavFile() {
+    if (this->f) {
+      fclose(this->f);
+    }
+  }
+
+  // Returns an error message, or nullptr on success
+  const char *open(const std::string &path) {
+    this->f = fopen(path.c_str(), "rb");
+    if (!this->f) {
+      return "couldn't open file";
+    }
+
+    unsigned char header[12];
+    if (fread(header, 1, 12, this->f) != 12 || memcmp(header, "RIFF", 4) ||
+        memcmp(header + 8, "WAVE", 4)) {
+      return "not a wav file";
+    }
+
+    bool have_format = false;
+    unsigned char chunk[8];
+    while (fread(chunk, 1, 8, this->f) == 8) {
+      uint32_t size = le32(chunk + 4);
+      if (!memcmp(chunk, "fmt ", 4)) {
+        unsigned char fmt[40];
+        if (size < 16 || size > sizeof(fmt) ||
+            fread(fmt, 1, size, this->f) != size) {
+          return "bad fmt chunk";
+        }
+        if (size & 1) {
+          fseek(this->f, 1, SEEK_CUR);
+        }
+        uint16_t tag = le16(fmt);
+        if (tag == 0xfffe && size >= 26) {
+          // WAVE_FORMAT_EXTENSIBLE; the real tag starts the subformat
+          tag = le16(fmt + 24);
+        }
+        if (tag == 1) {
+          this->encoding = pcm;
+        }
+        else if (tag == 3) {
+          this->encoding = ieee_float;
+        }
+        else {
+          return "unsupported wav encoding";
+        }
+        this->channels = le16(fmt + 2);
+        this->rate = le32(fmt + 4);
+        this->bytes_per_sample = le16(fmt + 14) / 8;
+        bool ok_width = this->encoding == pcm
+                            ? this->bytes_per_sample >= 1 &&
+                                  this->bytes_per_sample <= 4
+                            : this->bytes_per_sample == 4;
+        if (this->channels < 1 || this->rate < 1 || !ok_width) {
+          return "unsupported wav format";
+        }
+        have_format = true;
+      }
+      else if (!memcmp(chunk, "data", 4)) {
+        if (!have_format) {
+          return "wav data before format";
+        }
+        this->data_offset = ftell(this->f);
+        this->frames = size / (this->channels * this->bytes_per_sample);
+        return nullptr;
+      }
+      else if (fseek(this->f, size + (size & 1), SEEK_CUR)) {
+        break;
+      }
+    }
+    return "no wav data";
+  }
+
+  double seconds() { return (double)this->frames / this->rate; }
+
+  void seek(uint64_t frame) {
+    this->frame = std::min(frame, this->frames);
+    fseek(this->f,
+          this->data_offset +
+              this->frame * this->channels * this->bytes_per_sample,
+          SEEK_SET);
+  }
+
+  // Appends up to max frames to out, as floats in [-1, 1]. Returns
+  // the number of frames read.
+  size_t read(size_t max, std::vector<unsigned char> &raw,
+              std::vector<float> &out) {
+    size_t want = std::min((uint64_t)max, this->frames - this->frame);
+    size_t frame_bytes = this->channels * this->bytes_per_sample;
+    raw.resize(want * frame_bytes);
+    size_t got = fread(raw.data(), frame_bytes, want, this->f);
+    this->frame += got;
+
+    const unsigned char *p = raw.data();
+    for (size_t i = 0; i < got * this->channels; i++) {
+      float s;
+      switch (this->encoding == ieee_float ? 0 : this->bytes_per_sample) {
+      case 0: {
+        uint32_t bits = le32(p);
+        memcpy(&s, &bits, 4);
+        break;
+      }
+      case 1:
+        s = (p[0] - 128) / 128.0f;
+        break;
+      case 2:
+        s = (int16_t)le16(p) / 32768.0f;
+        break;
+      case 3:
+        s = (int32_t)((p[0] << 8) | (p[1] << 16) | ((uint32_t)p[2] << 24)) /
+            2147483648.0f;
+        break;
+      default:
+        s = (int32_t)le32(p) / 2147483648.0f;
+        break;
+      }
+      out.push_back(s);
+      p += this->bytes_per_sample;
+    }
+    return got;
+  }
+};
+
+Napi::FunctionReference Stream::constructor;
+
+Napi::Object Stream::Init(Napi::Env env, Napi::Object exports) {
+  Napi::Function func = DefineClass(
+      env, "Stream",
+      {
+          Stream::InstanceMethod("play", &Stream::play),
+          Stream::InstanceMethod("pause", &Stream::pause),
+          Stream::InstanceMethod("stop", &Stream::stop),
+          Stream::InstanceMethod("seek", &Stream::seek),
+          Stream::InstanceMethod("setLoop", &Stream::setLoop),
+          Stream::InstanceMethod("setVolume", &Stream::setVolume),
+          Stream::InstanceMethod("queue", &Stream::queue),
+          Stream::InstanceMethod("playing", &Stream::playing),
+          Stream::InstanceMethod("position", &Stream::position),
+          Stream::InstanceMethod("duration", &Stream::duration),
+          Stream::InstanceMethod("stats", &Stream::stats),
+      });
+
+  Stream::constructor = Napi::Persistent(func);
+  constructor.SuppressDestruct();
+
+  exports.Set(Napi::String::New(env, "Stream"), func);
+
+  return exports;
+}
+
+Stream::Stream(const Napi::CallbackInfo &info) : ObjectWrap(info) {
+  NBOILER();
+
+  if (info.Length() < 1 || !info[0].IsString()) {
+    throwJs(env, "usage: Stream(path: string)");
+    return;
+  }
+
+  Uint16 format;
+  if (!Mix_QuerySpec(&this->_rate, &format, &this->_channels)) {
+    throwJs(env, "audio isn't initialized");
+    return;
+  }
+  if (format != AUDIO_S16SYS) {
+    throwJs(env, "streams need 16-bit audio output");
+    return;
+  }
+
+  std::string path = info[0].As<Napi::String>().Utf8Value();
+  this->_file.reset(new WavFile());
+  if (const char *err = this->_file->open(path)) {
+    throwJs(env, path + ": " + err);
+    return;
+  }
+  if (const char *err = this->checkRate(*this->_file)) {
+    throwJs(env, path + ": " + err);
+    return;
+  }
+  this->_duration = this->_file->seconds();
+  this->_ring.resize(RING_SIZE);
+  this->mark(0);
+
+  this->_decoder = std::thread(&Stream::decodeLoop, this);
+
+  streams.push_back(this);
+  publishStreams();
+  if (!hooked) {
+    Mix_HookMusic(Stream::mix, nullptr);
+    hooked = true;
+  }
+}
+
+Stream::~Stream() {
+  streams.erase(std::remove(streams.begin(), streams.end(), this),
+                streams.end());
+  publishStreams();
+  this->stopDecoder();
+}
+
+void Stream::stopDecoder() {
+  {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    this->_quitting = true;
+  }
+  this->_cond.notify_one();
+  if (this->_decoder.joinable()) {
+    this->_decoder.join();
+  }
+}
+
+void Stream::closeAll() {
+  if (hooked) {
+    Mix_HookMusic(nullptr, nullptr);
+    hooked = false;
+  }
+  for (Stream *stream : streams) {
+    stream->_playing = false;
+    stream->stopDecoder();
+  }
+  streams.clear();
+  publishStreams();
+}
+
+void Stream::mix(void *udata, Uint8 *out, int len) {
+  mixing++;
+  // The mixer has already cleared out to silence
+  if (const std::vector<Stream *> *active = mixing_streams.load()) {
+    for (Stream *stream : *active) {
+      stream->mixInto((Sint16 *)out, len / sizeof(Sint16));
+    }
+  }
+  mixing--;
+}
+
+// Runs on the audio thread; mustn't block.
+void Stream::mixInto(Sint16 *out, size_t samples) {
+  uint64_t read = this->_read.load(std::memory_order_relaxed);
+  uint64_t discard = this->_discard_until.load(std::memory_order_acquire);
+  if (discard > read) {
+    read = discard;
+  }
+
+  if (this->_playing.load(std::memory_order_relaxed)) {
+    // Check for the end before looking at what's available, so we
+    // can't miss samples written just before it was set.
+    bool ended = this->_ended.load(std::memory_order_acquire);
+    uint64_t available =
+        this->_written.load(std::memory_order_acquire) - read;
+    size_t n = std::min((uint64_t)samples, available);
+    float volume = this->_volume.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < n; i++) {
+      int s = out[i] + (int)(this->_ring[(read + i) & RING_MASK] * volume);
+      out[i] = std::max(-32768, std::min(32767, s));
+    }
+    read += n;
+    if (n < samples && !ended) {
+      this->_underruns++;
+    }
+    // Data might still arrive if the stream is restarted or something
+    // is queued, in which case we just carry on.
+    this->_finished = ended && n == available;
+  }
+
+  this->_read.store(read, std::memory_order_release);
+}
+
+void Stream::mark(double seconds) {
+  uint64_t read = this->_read.load();
+  std::lock_guard<std::mutex> lock(this->_mutex);
+  // Forget the ones that have already been played past
+  while (this->_marks.size() > 1 && this->_marks[1].at <= read) {
+    this->_marks.pop_front();
+  }
+  this->_marks.push_back({this->_written.load(), seconds});
+}
+
+void Stream::resetResampler() {
+  this->_src.clear();
+  this->_src_pos = 0;
+}
+
+void Stream::decodeLoop() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(this->_mutex);
+      if (this->_quitting) {
+        return;
+      }
+    }
+
+    double seek = this->_seek_request.exchange(-1);
+    if (seek >= 0) {
+      WavFile &file = *this->_file;
+      file.seek((uint64_t)(seek * file.rate));
+      this->resetResampler();
+      this->_discard_until.store(this->_written.load(),
+                                 std::memory_order_release);
+      this->_ended = false;
+      {
+        // One lock, so position() never sees the marks empty
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_marks.clear();
+        this->_marks.push_back(
+            {this->_written.load(), (double)file.frame / file.rate});
+      }
+    }
+
+    bool more = !this->_ended && (this->decodeChunk() || this->advance());
+    if (!more) {
+      this->_ended = true;
+    }
+
+    if (more) {
+      // Ring is full
+      std::unique_lock<std::mutex> lock(this->_mutex);
+      this->_cond.wait_for(lock, DECODER_POLL, [this] {
+        return this->_quitting || this->_seek_request >= 0;
+      });
+    }
+    else {
+      // Wait for something to play
+      bool resume;
+      {
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        resume = this->_cond.wait_for(lock, DECODER_POLL, [this] {
+          return this->_quitting || this->_seek_request >= 0 ||
+                 this->canAdvance();
+        });
+        resume = resume && !this->_quitting && this->_seek_request < 0;
+      }
+      if (resume && this->advance()) {
+        this->_ended = false;
+      }
+    }
+  }
+}
+
+bool Stream::decodeChunk() {
+  WavFile &file = *this->_file;
+  const double step = (double)file.rate / this->_rate;
+  const int src_channels = file.channels;
+  const int channels = this->_channels;
+  uint64_t written = this->_written.load(std::memory_order_relaxed);
+
+  while (true) {
+    uint64_t space = RING_SIZE - (written - this->_read.load());
+    // Low source rates resample to more than a whole chunk's worth, so
+    // the read is sized to the space rather than the other way round.
+    size_t frames = framesFitting(space, step, channels);
+    if (frames == 0) {
+      break;
+    }
+
+    size_t got = file.read(frames, this->_raw, this->_src);
+    size_t src_frames = this->_src.size() / src_channels;
+
+    // Linear interpolation between neighbouring source frames. The
+    // last frame is kept for the next chunk to interpolate from.
+    while (this->_src_pos + 1 < src_frames) {
+      size_t i = (size_t)this->_src_pos;
+      float t = this->_src_pos - i;
+      const float *a = &this->_src[i * src_channels];
+      const float *b = a + src_channels;
+      for (int c = 0; c < channels; c++) {
+        float s;
+        if (channels == 1 && src_channels > 1) {
+          float sa = 0, sb = 0;
+          for (int k = 0; k < src_channels; k++) {
+            sa += a[k];
+            sb += b[k];
+          }
+          s = (sa + (sb - sa) * t) / src_channels;
+        }
+        else {
+          int k = c % src_channels;
+          s = a[k] + (b[k] - a[k]) * t;
+        }
+        s = std::max(-1.0f, std::min(1.0f, s));
+        this->_ring[written++ & RING_MASK] = (Sint16)(s * 32767);
+      }
+      this->_src_pos += step;
+    }
+    if (src_frames > 0) {
+      size_t consumed = std::min((size_t)this->_src_pos, src_frames - 1);
+      this->_src.erase(this->_src.begin(),
+                       this->_src.begin() + consumed * src_channels);
+      this->_src_pos -= consumed;
+    }
+    this->_written.store(written, std::memory_order_release);
+
+    if (got == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const char *Stream::checkRate(const WavFile &file) {
+  // Even a single source frame has to fit in an empty ring
+  if (framesFitting(RING_SIZE, (double)file.rate / this->_rate,
+                    this->_channels) == 0) {
+    return "sample rate too low to resample";
+  }
+  return nullptr;
+}
+
+bool Stream::canAdvance() { return this->_loop || !this->_queue.empty(); }
+
+bool Stream::advance() {
+  std::unique_ptr<WavFile> next;
+  {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    if (!this->_queue.empty()) {
+      next = std::move(this->_queue.front());
+      this->_queue.pop_front();
+    }
+  }
+
+  if (next) {
+    this->_file = std::move(next);
+    this->_duration = this->_file->seconds();
+  }
+  else if (this->_loop) {
+    this->_file->seek(0);
+  }
+  else {
+    return false;
+  }
+  // The previous track's last frame has nothing to interpolate with;
+  // dropping it is inaudible.
+  this->resetResampler();
+  this->mark(0);
+  return true;
+}
+
+NFUNC(Stream::play) {
+  NBOILER();
+
+  // Start over if we've played everything
+  if (this->_finished) {
+    this->_seek_request = 0;
+    this->_cond.notify_one();
+  }
+  this->_playing = true;
+
+  return env.Null();
+}
+
+NFUNC(Stream::pause) {
+  NBOILER();
+
+  this->_playing = false;
+
+  return env.Null();
+}
+
+NFUNC(Stream::stop) {
+  NBOILER();
+
+  this->_playing = false;
+  this->_seek_request = 0;
+  this->_cond.notify_one();
+
+  return env.Null();
+}
+
+// seek(seconds: number): void
+NFUNC(Stream::seek) {
+  NBOILER();
+
+  if (info.Length() < 1 || !info[0].IsNumber()) {
+    return throwJs(env, "usage: seek(seconds: number)");
+  }
+
+  // This is within whatever track the decoder has open, which near the
+  // end of one track might already be the next.
+  double seconds = info[0].As<Napi::Number>().DoubleValue();
+  this->_seek_request = std::max(0.0, seconds);
+  this->_cond.notify_one();
+
+  return env.Null();
+}
+
+NFUNC(Stream::setLoop) {
+  NBOILER();
+
+  if (info.Length() < 1 || !info[0].IsBoolean()) {
+    return throwJs(env, "usage: setLoop(loop: boolean)");
+  }
+
+  this->_loop = info[0].As<Napi::Boolean>().Value();
+  this->_cond.notify_one();
+
+  return env.Null();
+}
+
+NFUNC(Stream::setVolume) {
+  NBOILER();
+
+  if (info.Length() < 1 || !info[0].IsNumber()) {
+    return throwJs(env, "usage: setVolume(volume: number)");
+  }
+
+  this->_volume = info[0].As<Napi::Number>().FloatValue();
+
+  return env.Null();
+}
+
+// queue(path: string): void
+NFUNC(Stream::queue) {
+  NBOILER();
+
+  if (info.Length() < 1 || !info[0].IsString()) {
+    return throwJs(env, "usage: queue(path: string)");
+  }
+
+  std::string path = info[0].As<Napi::String>().Utf8Value();
+  std::unique_ptr<WavFile> file(new WavFile());
+  if (const char *err = file->open(path)) {
+    return throwJs(env, path + ": " + err);
+  }
+  if (const char *err = this->checkRate(*file)) {
+    return throwJs(env, path + ": " + err);
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    this->_queue.push_back(std::move(file));
+  }
+  this->_cond.notify_one();
+
+  return env.Null();
+}
+
+NFUNC(Stream::playing) {
+  NBOILER();
+
+  return Napi::Boolean::New(env, this->_playing && !this->_finished);
+}
+
+// Seconds into the track that's currently audible
+NFUNC(Stream::position) {
+  NBOILER();
+
+  uint64_t read = this->_read.load();
+  std::lock_guard<std::mutex> lock(this->_mutex);
+  while (this->_marks.size() > 1 && this->_marks[1].at <= read) {
+    this->_marks.pop_front();
+  }
+  const Mark &mark = this->_marks.front();
+  uint64_t since = read > mark.at ? read - mark.at : 0;
+
+  return Napi::Number::New(env, mark.seconds + (double)since /
+                                                   this->_channels /
+                                                   this->_rate);
+}
+
+NFUNC(Stream::duration) {
+  NBOILER();
+
+  return Napi::Number::New(env, this->_duration);
+}
+
+NFUNC(Stream::stats) {
+  NBOILER();
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("buffered",
+             Napi::Number::New(env, this->_written - this->_read));
+  result.Set("underruns", Napi::Number::New(env, this->_underruns));
+
+  return result;
+}
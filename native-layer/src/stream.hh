@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_mixer.h>
+
+#include "napi-helpers.hh"
+#include <napi.h>
+
+struct WavFile;
+
+// Plays an audio file from disk without ever holding all of it in
+// memory. A decoder thread per stream reads the file a chunk at a time,
+// converts it to the mixer's format, and writes it into a ring buffer;
+// the audio callback reads from the ring without taking any locks. The
+// decoder tries to keep the ring full, so it's only the ring (about
+// 1.5s of audio, see RING_SIZE) that's resident.
+//
+// When a track ends, the next one passed to queue() starts with no gap.
+// The last track loops if setLoop(true).
+//
+// Only wav files are supported, in any of the usual pcm formats.
+class Stream : public Napi::ObjectWrap<Stream> {
+public:
+  Stream(const Napi::CallbackInfo &info);
+  ~Stream();
+
+  NFUNC(play);
+  NFUNC(pause);
+  NFUNC(stop);
+  NFUNC(seek);
+  NFUNC(setLoop);
+  NFUNC(setVolume);
+  NFUNC(queue);
+  NFUNC(playing);
+  NFUNC(position);
+  NFUNC(duration);
+  NFUNC(stats);
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+  // Stops every stream's decoder and detaches from the mixer. Called
+  // before audio is shut down.
+  static void closeAll();
+
+  static Napi::FunctionReference constructor;
+
+private:
+  // Where a track (or a seek within one) starts in the ring's sample
+  // sequence, so we can tell what's being heard.
+  struct Mark {
+    uint64_t at;
+    double seconds;
+  };
+
+  // Audio callback; mixes every playing stream into out.
+  static void mix(void *udata, Uint8 *out, int len);
+  void mixInto(Sint16 *out, size_t samples);
+
+  void decodeLoop();
+  // Fills the ring with as much as fits, or until the track ends.
+  // Returns false at the end of the track.
+  bool decodeChunk();
+  // Makes the next track, or the start of this one if looping,
+  // current. Returns false if there's nothing more to play.
+  bool advance();
+  bool canAdvance(); // call with _mutex held
+  // Returns an error if file's rate is too low to ever fit in the ring
+  const char *checkRate(const WavFile &file);
+  void resetResampler();
+  void mark(double seconds);
+  void stopDecoder();
+
+  int _rate, _channels; // the mixer's
+
+  std::vector<Sint16> _ring;
+  std::atomic<uint64_t> _written{0}; // samples, only the decoder writes
+  std::atomic<uint64_t> _read{0};    // samples, only the mixer writes
+  // The mixer skips ahead to here; set by the decoder after a seek.
+  std::atomic<uint64_t> _discard_until{0};
+
+  std::atomic<bool> _playing{false};
+  std::atomic<bool> _loop{false};
+  std::atomic<float> _volume{1.0f};
+  std::atomic<bool> _ended{false};    // decoder has nothing left to write
+  std::atomic<bool> _finished{false}; // and the mixer has played it all
+  std::atomic<double> _seek_request{-1}; // seconds, negative if none
+  std::atomic<double> _duration{0};
+  std::atomic<size_t> _underruns{0};
+
+  // Everything below is shared between the js thread and the decoder
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  bool _quitting = false;
+  std::deque<std::unique_ptr<WavFile>> _queue;
+  std::deque<Mark> _marks;
+  std::thread _decoder;
+
+  // Decoder thread only
+  std::unique_ptr<WavFile> _file;
+  std::vector<float> _src; // source frames, first is carried over
+  double _src_pos = 0;     // fractional index into _src
+  std::vector<unsigned char> _raw;
+};
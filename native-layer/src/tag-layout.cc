@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <iostream>
+
+#include "gen/config.h"
+#include "tag-layout.hh"
+
+namespace {
+
+const std::u16string bg_prefix = u"bg-";
+
+bool startsWith(const std::u16string &s, const std::u16string &prefix) {
+  return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Entity names are all ascii, so that's all we need to handle
+std::u16string toUpper(std::u16string s) {
+  for (char16_t &c : s) {
+    if (c >= u'a' && c <= u'z') {
+      c = c - u'a' + u'A';
+    }
+  }
+  return s;
+}
+
+} // namespace
+
+Napi::FunctionReference TagLayout::constructor;
+
+Napi::Object TagLayout::Init(Napi::Env env, Napi::Object exports) {
+  Napi::Function func =
+      DefineClass(env, "TagLayout",
+                  {
+                      TagLayout::InstanceMethod("draw", &TagLayout::draw),
+                      TagLayout::InstanceMethod("stats", &TagLayout::stats),
+                  });
+
+  TagLayout::constructor = Napi::Persistent(func);
+  constructor.SuppressDestruct();
+
+  exports.Set(Napi::String::New(env, "TagLayout"), func);
+
+  return exports;
+}
+
+TagLayout::TagLayout(const Napi::CallbackInfo &info) : ObjectWrap(info) {
+  NBOILER();
+
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    throwJs(env, "usage: TagLayout(config: TagLayoutConfig, "
+                 "cacheSize?: number)");
+    return;
+  }
+
+  Napi::Object config = info[0].As<Napi::Object>();
+  Napi::Array colors = config.Get("colors").As<Napi::Array>();
+  for (uint32_t i = 0; i < colors.Length(); i++) {
+    this->_colors.push_back(colors.Get(i).As<Napi::String>().Utf16Value());
+  }
+  Napi::Array entities = config.Get("entities").As<Napi::Array>();
+  for (uint32_t i = 0; i < entities.Length(); i++) {
+    Napi::Array entity = entities.Get(i).As<Napi::Array>();
+    this->_entities[entity.Get((uint32_t)0).As<Napi::String>().Utf16Value()] =
+        entity.Get((uint32_t)1).As<Napi::Number>().Uint32Value();
+  }
+
+  if (info.Length() >= 2 && info[1].IsNumber()) {
+    this->_capacity = info[1].As<Napi::Number>().Uint32Value();
+  }
+  if (this->_capacity == 0) {
+    this->_capacity = 1;
+  }
+}
+
+int TagLayout::colorOf(const std::u16string &name) {
+  auto found = std::find(this->_colors.begin(), this->_colors.end(), name);
+  return found == this->_colors.end() ? -1 : found - this->_colors.begin();
+}
+
+bool TagLayout::applyTag(const std::u16string &tag, uint8_t base,
+                         uint8_t &attr, std::vector<Cell> &cells) {
+  if (startsWith(tag, bg_prefix)) {
+    int color = this->colorOf(tag.substr(bg_prefix.size()));
+    if (color >= 0) {
+      attr = (attr & 15) | (color << 4);
+      return true;
+    }
+  }
+  int color = this->colorOf(tag);
+  if (color >= 0) {
+    attr = (attr & ~15) | color;
+    return true;
+  }
+  if (tag == u"/") {
+    attr = base;
+    return true;
+  }
+  auto entity = this->_entities.find(toUpper(tag));
+  if (entity != this->_entities.end()) {
+    cells.push_back({entity->second, attr});
+    return true;
+  }
+  return false;
+}
+
+std::vector<TagLayout::Cell> TagLayout::parse(const std::u16string &str,
+                                              uint8_t base) {
+  std::vector<Cell> cells;
+  uint8_t attr = base;
+  size_t pos = 0;
+  while (true) {
+    size_t open = str.find(u'{', pos);
+    size_t close =
+        open == std::u16string::npos ? open : str.find(u'}', open + 1);
+    if (open != std::u16string::npos && close == std::u16string::npos) {
+      break;
+    }
+    // Text before the tag, or the rest if there isn't one
+    size_t end = std::min(open, str.size());
+    for (size_t i = pos; i < end; i++) {
+      cells.push_back({str[i], attr});
+    }
+    if (open == std::u16string::npos) {
+      return cells;
+    }
+    if (!this->applyTag(str.substr(open + 1, close - open - 1), base, attr,
+                        cells)) {
+      break;
+    }
+    pos = close + 1;
+  }
+
+  // Same fallback as parseTagstrSafe
+  std::cerr << "tag-layout: don't know how to parse "
+            << Napi::String::New(this->Env(), str).Utf8Value() << std::endl;
+  cells.clear();
+  for (char16_t ch : str) {
+    cells.push_back({ch, base});
+  }
+  return cells;
+}
+
+const std::vector<TagLayout::Cell> &
+TagLayout::lookup(const std::u16string &str, uint8_t attr) {
+  std::u16string key = char16_t(attr) + str;
+  auto found = this->_index.find(key);
+  if (found != this->_index.end()) {
+    this->_hits++;
+    this->_lru.splice(this->_lru.begin(), this->_lru, found->second);
+    return found->second->cells;
+  }
+
+  this->_misses++;
+  this->_lru.push_front({key, this->parse(str, attr)});
+  this->_index[key] = this->_lru.begin();
+  if (this->_lru.size() > this->_capacity) {
+    this->_index.erase(this->_lru.back().key);
+    this->_lru.pop_back();
+  }
+  return this->_lru.front().cells;
+}
+
+// draw(data: Uint8Array, state: StrState, str: string, attr: number,
+//      len: number): void
+NFUNC(TagLayout::draw) {
+  NBOILER();
+
+  if (info.Length() < 5 || !info[0].IsTypedArray() || !info[1].IsObject() ||
+      !info[2].IsString() || !info[3].IsNumber() || !info[4].IsNumber()) {
+    return throwJs(env, "usage: draw(data: Uint8Array, state: StrState, "
+                        "str: string, attr: number, len: number)");
+  }
+
+  Napi::TypedArrayOf<uint8_t> array =
+      info[0].As<Napi::TypedArrayOf<uint8_t>>();
+  Napi::Object state = info[1].As<Napi::Object>();
+  Napi::Object p = state.Get("p").As<Napi::Object>();
+  int x = p.Get("x").As<Napi::Number>().Int32Value();
+  int y = p.Get("y").As<Napi::Number>().Int32Value();
+  int start_x = state.Get("start")
+                    .As<Napi::Object>()
+                    .Get("x")
+                    .As<Napi::Number>()
+                    .Int32Value();
+  Napi::Value wrap_value = state.Get("wrapLen");
+  bool wrap = !wrap_value.IsUndefined();
+  int wrap_len = wrap ? wrap_value.As<Napi::Number>().Int32Value() : 0;
+  uint8_t base = info[3].As<Napi::Number>().Uint32Value();
+  int len = info[4].As<Napi::Number>().Int32Value();
+
+  uint8_t *data = array.Data();
+  int64_t size = array.ElementLength();
+  // Out of range writes are dropped, like they are for typed arrays
+  auto put = [&](char16_t ch, uint8_t attr) {
+    if (ch == u'\n') {
+      y++;
+      x = start_x;
+      return;
+    }
+    int64_t i = 4 * ((int64_t)y * config::TEXT_PAGE_W + x);
+    if (i >= 0 && i < size) {
+      data[i] = ch & 0xff;
+    }
+    if (i + 1 >= 0 && i + 1 < size) {
+      data[i + 1] = attr;
+    }
+    x++;
+    if (wrap && x - start_x >= wrap_len) {
+      y++;
+      x = start_x;
+    }
+  };
+
+  const std::vector<Cell> &cells =
+      this->lookup(info[2].As<Napi::String>().Utf16Value(), base);
+  size_t n = len < 0 ? cells.size() : std::min(cells.size(), (size_t)len);
+  for (size_t i = 0; i < n; i++) {
+    put(cells[i].ch, cells[i].attr);
+  }
+  for (int i = (int)cells.size(); i < len; i++) {
+    put(u' ', base);
+  }
+
+  p.Set("x", Napi::Number::New(env, x));
+  p.Set("y", Napi::Number::New(env, y));
+  return env.Undefined();
+}
+
+// stats(): TagLayoutStats
+NFUNC(TagLayout::stats) {
+  NBOILER();
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("hits", Napi::Number::New(env, this->_hits));
+  result.Set("misses", Napi::Number::New(env, this->_misses));
+  result.Set("size", Napi::Number::New(env, this->_lru.size()));
+  return result;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <napi.h>
+
+#include "napi-helpers.hh"
+
+// Native counterpart of layoutTagStr in src/ui/tag-layout.ts. Tag
+// strings are parsed, the same way as parseTagstr, into the cells
+// they'll occupy, and cached on the string and the attr they start
+// out in; drawing is then a copy into the text page.
+class TagLayout : public Napi::ObjectWrap<TagLayout> {
+public:
+  TagLayout(const Napi::CallbackInfo &info);
+  NFUNC(draw);
+  NFUNC(stats);
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+  static Napi::FunctionReference constructor;
+
+private:
+  struct Cell {
+    char16_t ch; // newline moves down instead of being drawn
+    uint8_t attr;
+  };
+
+  struct CacheEntry {
+    std::u16string key; // attr, then the string
+    std::vector<Cell> cells;
+  };
+
+  const std::vector<Cell> &lookup(const std::u16string &str, uint8_t attr);
+  std::vector<Cell> parse(const std::u16string &str, uint8_t attr);
+  // Returns false if tag isn't one we know
+  bool applyTag(const std::u16string &tag, uint8_t base, uint8_t &attr,
+                std::vector<Cell> &cells);
+  int colorOf(const std::u16string &name);
+
+  std::vector<std::u16string> _colors;
+  std::unordered_map<std::u16string, char16_t> _entities;
+
+  size_t _capacity = 4096;
+  std::list<CacheEntry> _lru; // most recently used at the front
+  std::unordered_map<std::u16string, std::list<CacheEntry>::iterator> _index;
+  size_t _hits = 0, _misses = 0;
+};
@@ -0,0 +1,212 @@
+#include <cmath>
+#include <cstdlib>
+
+#include "virtual-gen.hh"
+
+namespace {
+
+// Bit-for-bit the same as Rand in src/util/util.ts, including its
+// double precision arithmetic. This relies on the compiler not fusing
+// the multiply and add, hence -ffp-contract=off in binding.gyp.
+class Rand {
+public:
+  Rand(double seed) : _n(seed == 0 || std::isnan(seed) ? 42 : seed) {
+    for (int i = 0; i < 3; i++) {
+      this->f();
+    }
+  }
+
+  double f() {
+    double product = 2147483629.0 * this->_n;
+    this->_n = std::fmod(product + 2147483587.0, 2147483647.0);
+    return ((int64_t)this->_n & 0xffff) / (double)(1 << 16);
+  }
+
+  int i(int n) { return (int)std::floor(this->f() * n); }
+
+private:
+  double _n;
+};
+
+uint64_t fnv1a(const std::string &s) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (unsigned char c : s) {
+    h ^= c;
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+// Matches /^dir-(\d+)$/
+bool dirSeed(const std::string &ident, double &seed) {
+  const std::string prefix = "dir-";
+  if (ident.size() <= prefix.size() ||
+      ident.compare(0, prefix.size(), prefix) != 0) {
+    return false;
+  }
+  for (size_t i = prefix.size(); i < ident.size(); i++) {
+    if (ident[i] < '0' || ident[i] > '9') {
+      return false;
+    }
+  }
+  seed = strtod(ident.c_str() + prefix.size(), nullptr);
+  return true;
+}
+
+} // namespace
+
+Napi::FunctionReference VirtualGen::constructor;
+
+Napi::Object VirtualGen::Init(Napi::Env env, Napi::Object exports) {
+  Napi::Function func =
+      DefineClass(env, "VirtualGen",
+                  {
+                      VirtualGen::InstanceMethod("plans", &VirtualGen::plans),
+                      VirtualGen::InstanceMethod("stats", &VirtualGen::stats),
+                  });
+
+  VirtualGen::constructor = Napi::Persistent(func);
+  constructor.SuppressDestruct();
+
+  exports.Set(Napi::String::New(env, "VirtualGen"), func);
+
+  return exports;
+}
+
+VirtualGen::VirtualGen(const Napi::CallbackInfo &info) : ObjectWrap(info) {
+  NBOILER();
+
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    throwJs(env, "usage: VirtualGen(config: VirtualGenConfig, "
+                 "cacheSize?: number)");
+    return;
+  }
+
+  Napi::Object config = info[0].As<Napi::Object>();
+  Napi::Array surnames = config.Get("surnames").As<Napi::Array>();
+  for (uint32_t i = 0; i < surnames.Length(); i++) {
+    this->_surnames.push_back(surnames.Get(i).As<Napi::String>().Utf8Value());
+  }
+  if (this->_surnames.empty()) {
+    throwJs(env, "config.surnames should be nonempty");
+    return;
+  }
+  this->_fanout = config.Get("fanout").As<Napi::Number>().Int32Value();
+  this->_id_range = config.Get("idRange").As<Napi::Number>().Int32Value();
+  Napi::Array specials = config.Get("specials").As<Napi::Array>();
+  for (uint32_t i = 0; i < specials.Length(); i++) {
+    Napi::Array special = specials.Get(i).As<Napi::Array>();
+    this->_specials.push_back(
+        {special.Get((uint32_t)0).As<Napi::Number>().DoubleValue(),
+         special.Get((uint32_t)1).As<Napi::String>().Utf8Value()});
+  }
+
+  if (info.Length() >= 2 && info[1].IsNumber()) {
+    this->_capacity = info[1].As<Napi::Number>().Uint32Value();
+  }
+  if (this->_capacity == 0) {
+    this->_capacity = 1;
+  }
+}
+
+std::string VirtualGen::randomName(double seed) {
+  Rand rand(seed);
+  std::string name(1, 'a' + rand.i(26));
+  if (rand.i(4) == 0) {
+    name += (char)('a' + rand.i(26));
+  }
+  return name + this->_surnames[rand.i(this->_surnames.size())];
+}
+
+VirtualGen::Plan VirtualGen::generate(const std::string &ident) {
+  double seed;
+  bool is_dir_id = dirSeed(ident, seed);
+  std::string name = is_dir_id ? this->randomName(seed) : ident;
+
+  if (ident == "vroot") {
+    seed = 0;
+  }
+  else if (!is_dir_id) {
+    return {false, name, {}};
+  }
+
+  Plan plan = {true, name, {}};
+  Rand rand(seed);
+  for (int i = 0; i < this->_fanout; i++) {
+    plan.contents.push_back("dir-" + std::to_string(rand.i(this->_id_range)));
+  }
+  for (const auto &special : this->_specials) {
+    if (seed < special.first) {
+      plan.contents.push_back(special.second);
+      break;
+    }
+  }
+  return plan;
+}
+
+const VirtualGen::Plan &VirtualGen::lookup(const std::string &ident) {
+  uint64_t key = fnv1a(ident);
+  auto found = this->_index.find(key);
+  if (found != this->_index.end() && found->second->ident == ident) {
+    this->_hits++;
+    this->_lru.splice(this->_lru.begin(), this->_lru, found->second);
+    return found->second->plan;
+  }
+
+  this->_misses++;
+  if (found != this->_index.end()) {
+    // Hash collision; the newcomer takes the slot
+    this->_lru.erase(found->second);
+    this->_index.erase(found);
+  }
+  this->_lru.push_front({key, ident, this->generate(ident)});
+  this->_index[key] = this->_lru.begin();
+  if (this->_lru.size() > this->_capacity) {
+    this->_index.erase(this->_lru.back().key);
+    this->_lru.pop_back();
+  }
+  return this->_lru.front().plan;
+}
+
+// plans(paths: string[]): VirtualItemPlan[]
+NFUNC(VirtualGen::plans) {
+  NBOILER();
+
+  if (info.Length() < 1 || !info[0].IsArray()) {
+    return throwJs(env, "usage: plans(paths: string[])");
+  }
+
+  Napi::Array paths = info[0].As<Napi::Array>();
+  Napi::Array result = Napi::Array::New(env, paths.Length());
+  for (uint32_t i = 0; i < paths.Length(); i++) {
+    std::string path = paths.Get(i).As<Napi::String>().Utf8Value();
+    size_t slash = path.rfind('/');
+    const Plan &plan = this->lookup(
+        slash == std::string::npos ? path : path.substr(slash + 1));
+
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("t", Napi::String::New(env, plan.dir ? "dir" : "file"));
+    obj.Set("name", Napi::String::New(env, plan.name));
+    if (plan.dir) {
+      Napi::Array contents = Napi::Array::New(env, plan.contents.size());
+      for (uint32_t j = 0; j < plan.contents.size(); j++) {
+        contents.Set(j, Napi::String::New(env, plan.contents[j]));
+      }
+      obj.Set("contents", contents);
+    }
+    result.Set(i, obj);
+  }
+
+  return result;
+}
+
+NFUNC(VirtualGen::stats) {
+  NBOILER();
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("hits", Napi::Number::New(env, this->_hits));
+  result.Set("misses", Napi::Number::New(env, this->_misses));
+  result.Set("size", Napi::Number::New(env, this->_lru.size()));
+
+  return result;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <napi.h>
+
+#include "napi-helpers.hh"
+
+// Native counterpart of the procedural generator in src/fs/vfs.ts.
+// It has to produce exactly the same plans, since the browser version
+// of the game still uses the typescript one; the config passed in from
+// virtualGenConfig() keeps the two agreeing on content.
+//
+// A plan only depends on the last component of a virtual path, so
+// that's what we cache on, hashed. Deep trees reuse the same thousand
+// or so directory ids over and over, which makes for a high hit rate.
+class VirtualGen : public Napi::ObjectWrap<VirtualGen> {
+public:
+  VirtualGen(const Napi::CallbackInfo &info);
+  NFUNC(plans);
+  NFUNC(stats);
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+  static Napi::FunctionReference constructor;
+
+private:
+  struct Plan {
+    bool dir;
+    std::string name;
+    std::vector<std::string> contents;
+  };
+
+  struct CacheEntry {
+    uint64_t key;
+    std::string ident; // to rule out hash collisions
+    Plan plan;
+  };
+
+  const Plan &lookup(const std::string &ident);
+  Plan generate(const std::string &ident);
+  std::string randomName(double seed);
+
+  std::vector<std::string> _surnames;
+  int _fanout = 5;
+  int _id_range = 1000;
+  std::vector<std::pair<double, std::string>> _specials;
+
+  size_t _capacity = 4096;
+  std::list<CacheEntry> _lru; // most recently used at the front
+  std::unordered_map<uint64_t, std::list<CacheEntry>::iterator> _index;
+  size_t _hits = 0, _misses = 0;
+};
@@ -6,6 +6,21 @@ export class ProgramId { private _ProgramId(): void }
 export class FramebufferId { private _FramebufferId(): void }
 export class TextureId { private _TextureId(): void }
 
+export type CaptureStats = {
+  captured: number, // frames due for capture so far
+  dropped: number,  // skipped because readback or writing fell behind
+  written: number,
+  width: number, // of every frame, in pixels
+  height: number,
+};
+
+export type WindowSize = {
+  width: number, // in screen coordinates
+  height: number,
+  drawableWidth: number, // in pixels; bigger than the above on HiDPI
+  drawableHeight: number,
+};
+
 // Main classes
 
 export class NativeLayer {
@@ -16,14 +31,155 @@ export class NativeLayer {
   clear(): void;
   swapWindow(): void;
   finish(): void;
+  windowSize(): WindowSize;
+  // Returns the new size if the window has changed size or pixel
+  // density since the last call.
+  pollResize(): WindowSize | null;
+  // Records frames at up to fps while running. If path ends in .png it
+  // should contain a frame number pattern like "cap-%05d.png";
+  // otherwise frames are appended to path as raw top-down rgba. Every
+  // frame is the drawable size at the start, so if that changes the
+  // capture stops, as if by stopCapture.
+  startCapture(path: string, fps: number): void;
+  // Waits for queued frames to be written; null if not capturing.
+  stopCapture(): CaptureStats | null;
+  captureStats(): CaptureStats | null;
+  // Logs every key event pollEvent returns, with timestamps, for
+  // later use with EventReplay.
+  startRecording(path: string): void;
+  // Returns the number of events recorded, or null if not recording.
+  stopRecording(): number | null;
+}
+
+export type ReplayEvent = {
+  t: number,   // milliseconds since recording started
+  key: string, // as returned by NativeLayer.pollEvent
+};
+
+export class EventReplay {
+  constructor(path: string);
+  next(): ReplayEvent | null;
+  length(): number;
+  rewind(): void;
+}
+
+export type VirtualGenConfig = {
+  surnames: string[],
+  fanout: number,
+  idRange: number,
+  specials: [number, string][],
+};
+
+export type VirtualItemPlan =
+  | { t: 'file', name: string }
+  | { t: 'dir', name: string, contents: string[] };
+
+export type VirtualGenStats = {
+  hits: number,
+  misses: number,
+  size: number,
+};
+
+// Generates the same plans as virtualPlanOfIdent in src/fs/vfs.ts,
+// keeping the most recent cacheSize of them.
+export class VirtualGen {
+  constructor(config: VirtualGenConfig, cacheSize?: number);
+  plans(paths: string[]): VirtualItemPlan[];
+  stats(): VirtualGenStats;
+}
+
+export type CompiledExecutable = {
+  cycles: number,
+  cpuCost: number,
+  numTargets: number,
+  code: number[],
+};
+
+// Runs batches of executions like runExecBatch in src/core/exec-batch.ts,
+// with programs from compiledPrograms(). Updates items in place and
+// returns the number of steps that ran.
+export class ExecEngine {
+  constructor(programs: (CompiledExecutable | null)[]);
+  run(items: Float64Array, steps: Int32Array): number;
+}
+
+export type TagLayoutConfig = {
+  colors: string[],
+  entities: [string, number][],
+};
+
+export type StrState = {
+  start: { x: number, y: number },
+  p: { x: number, y: number },
+  wrapLen?: number,
+};
+
+export type TagLayoutStats = {
+  hits: number,
+  misses: number,
+  size: number,
+};
+
+// Draws tag strings like layoutTagStr in src/ui/tag-layout.ts, keeping
+// the most recent cacheSize of them parsed.
+export class TagLayout {
+  constructor(config: TagLayoutConfig, cacheSize?: number);
+  draw(data: Uint8Array, state: StrState, str: string, attr: number, len: number): void;
+  stats(): TagLayoutStats;
 }
 
+// Source of the named shader specialized at build time, or null if
+// there's no variant of it. Throws unless configHash, from configHash()
+// in src/ui/native-config.ts, matches the config it was built with.
+export function getShaderVariant(name: string, configHash: string): string | null;
+
 export function glUniform1i(uniform: UniformLoc, value: number): void;
 export function glUniform1f(uniform: UniformLoc, value: number): void;
 export function glUniform2f(uniform: UniformLoc, value: number, value2: number): void;
 export function glActiveTexture(textureUnit: number): void;
 export function glUniform4fv(uniform: UniformLoc, values: number[]): void;
-export function glTexImage2d(width: number, height: number, values: Uint8Array): void;
+
+export type ResourceCounts = {
+  count: number,   // currently live
+  bytes: number,   // estimated gpu memory of live objects
+  created: number, // total ever created
+  deleted: number, // total ever released
+};
+
+export type ResourceStats = {
+  texture: ResourceCounts,
+  framebuffer: ResourceCounts,
+  program: ResourceCounts,
+  shader: ResourceCounts,
+  pendingDeletes: number, // released, waiting for the end of the frame
+  vramBudget: number,     // 0 means unlimited
+  evictions: number,
+  reloads: number,
+};
+
+export function getResourceStats(): ResourceStats;
+// Textures loaded from files are evicted least-recently-used first
+// when texture memory exceeds the budget, and reloaded on next bind.
+export function setVramBudget(bytes: number): void;
+
+export type CallCounts = { issued: number, elided: number };
+
+export type GlStateStats = {
+  useProgram: CallCounts,
+  bindFramebuffer: CallCounts,
+  bindVertexArray: CallCounts,
+  activeTexture: CallCounts,
+  bindTexture: CallCounts,
+  blend: CallCounts,
+  viewport: CallCounts,
+  issued: number, // totals over all of the above
+  elided: number,
+};
+
+// Counts of state-changing gl calls that were sent to the driver vs.
+// skipped because they wouldn't have changed anything.
+export function getGlStateStats(): GlStateStats;
+export function resetGlStateStats(): void;
 
 export function initSound(): void;
 export function playSound(): void; // debugging for now
@@ -32,8 +188,12 @@ export class Texture {
   constructor();
   loadFile(filename: string): void;
   textureId(): TextureId;
+  // Doesn't necessarily make textureUnit active, if the texture is
+  // already bound there.
   bind(textureUnit: number): void;
   makeBlank(width: number, height: number): void;
+  // Replaces the contents with width x height rgba pixels
+  setPixels(width: number, height: number, data: Uint8Array): void;
 }
 
 export class Sample {
@@ -41,6 +201,34 @@ export class Sample {
   play();
 }
 
+export type StreamStats = {
+  buffered: number,  // decoded samples waiting to be played
+  underruns: number, // times the decoder fell behind playback
+};
+
+// Plays a wav file from disk, decoding it as it goes. Hold on to the
+// Stream for as long as it should keep playing.
+export class Stream {
+  constructor(path: string);
+  // Resumes, or starts over if everything has been played
+  play(): void;
+  pause(): void;
+  // Pauses and rewinds
+  stop(): void;
+  seek(seconds: number): void;
+  // Whether the last track starts over when it ends
+  setLoop(loop: boolean): void;
+  setVolume(volume: number): void;
+  // Plays path straight after the current track, with no gap
+  queue(path: string): void;
+  playing(): boolean;
+  // Seconds into the track being heard
+  position(): number;
+  // Length in seconds of the track the decoder is on
+  duration(): number;
+  stats(): StreamStats;
+}
+
 export class Program {
   constructor(vertexShader: string, fragmentShader: string);
   getUniformLocation(name: string): UniformLoc;
@@ -51,7 +239,11 @@ export class Program {
 export class Framebuffer {
   constructor();
   framebufferId(): FramebufferId;
+  // Sets the viewport to the output texture's size, if known
   bind(): void;
+  // Goes back to drawing to the window, with the window's viewport
   unbind(): void;
-  setOutputTexture(textureId: TextureId): void;
+  // Also binds this framebuffer. Pass the texture's size so that bind()
+  // can set the viewport to match.
+  setOutputTexture(textureId: TextureId, width?: number, height?: number): void;
 }
@@ -4,6 +4,11 @@ precision mediump float;
 in vec2 v_uv; // range is [0,1] x [0,1]
 out vec4 outputColor;
 
+// BEGIN CONFIG
+// The native build replaces this section with literal values; see
+// src/ui/gen-native.ts. Keep anything that depends on ui-constants.ts
+// or the palette in here.
+
 // Size of the 'screen' in pixels, something like
 // vec2(SCALE * COLS * char_size.x, SCALE * ROWS * char_size.y)
 uniform vec2 u_canvasSize;
@@ -13,16 +18,6 @@ const int COLS = 48;
 const int TEXT_PAGE_W = 48;
 const int TEXT_PAGE_H = 18;
 
-// XXX this is dead code, right?
-uniform sampler2D u_screenTexture;
-
-uniform sampler2D u_fontTexture;
-
-// a TEXT_PAGE_W * ROWS texture. Each pixel has
-// - red channel contsin a character code
-// - green channel high nybble is bgcolor, low nybble is fgcolor
-uniform sampler2D u_textPageTexture;
-
 // Color codes index into this palette:
 uniform vec4 u_palette[16];
 
@@ -32,6 +27,17 @@ const ivec2 char_size = ivec2(6, 12);
 int SCALE() {
   return int(u_canvasSize.x / float(COLS * char_size.x) + 0.5); // how big a single pixel is
 }
+// END CONFIG
+
+// XXX this is dead code, right?
+uniform sampler2D u_screenTexture;
+
+uniform sampler2D u_fontTexture;
+
+// a TEXT_PAGE_W * ROWS texture. Each pixel has
+// - red channel contsin a character code
+// - green channel high nybble is bgcolor, low nybble is fgcolor
+uniform sampler2D u_textPageTexture;
 
 const int FCHAR_W = 32; // how many characters per row in font texture
 
@@ -1,4 +1,4 @@
-import { Sample } from 'native-layer';
+import { Sample, Stream } from 'native-layer';
 import { mapSounds, makeSounds, AllSounds } from '../../src/ui/synth';
 
 function makeSample(buf: Float32Array): Sample {
@@ -8,3 +8,10 @@ function makeSample(buf: Float32Array): Sample {
 export function initSounds(): AllSounds<Sample> {
   return mapSounds(makeSample, makeSounds());
 }
+
+export function startAmbient(path: string): Stream {
+  const stream = new Stream(path);
+  stream.setLoop(true);
+  stream.play();
+  return stream;
+}
@@ -1,21 +1,42 @@
 import * as nat from 'native-layer';
-import { NativeLayer } from 'native-layer';
+import { NativeLayer, WindowSize } from 'native-layer';
 import { mkGameState } from "../../src/core/model";
+import { configHash } from '../../src/ui/native-config';
 import * as palette from '../../src/ui/palette';
 import { render } from '../../src/ui/render';
 import * as shader from './shaders';
 import { Screen } from '../../src/ui/screen';
-import { DrawParams } from '../../src/ui/ui-constants';
-
-const width = 1280;
-const height = 800;
-// XXX HARDCODED
-const ROWS = 18;
-const COLS = 48;
+import { DrawParams } from '../../src/ui/draw-params';
+import { char_size, COLS, ROWS, SCALE } from '../../src/ui/ui-constants';
+
+// Window size, in screen coordinates. Can change if the window is
+// resized.
+let width = 1280;
+let height = 800;
+const screen_width = COLS * char_size.x * SCALE;
+const screen_height = ROWS * char_size.y * SCALE;
+
+// Fraction of the screen's full pixel resolution that the text pass
+// renders at; the post pass scales it back up. 1 is full quality, and
+// 1 / SCALE, the cheapest setting that still has one texel per font
+// pixel, is much easier on fill rate for weak gpus and software
+// rendering.
+//
+// UPSILON_RENDER_SCALE can be a decimal or a fraction like 1/3. It has
+// to be in (0, 1]; anything else means 1.
+function parseRenderScale(str: string | undefined): number {
+  if (str == undefined)
+    return 1;
+  const parts = str.split('/');
+  const scale = parts.length == 2 ? Number(parts[0]) / Number(parts[1]) : Number(str);
+  if (parts.length > 2 || !Number.isFinite(scale) || scale <= 0 || scale > 1) {
+    console.error(`ignoring UPSILON_RENDER_SCALE=${str}, should be in (0, 1]`);
+    return 1;
+  }
+  return scale;
+}
 
-const SCALE = 3;
-const screen_width = COLS * 6 * SCALE;
-const screen_height = ROWS * 12 * SCALE;
+const RENDER_SCALE = parseRenderScale(process.env['UPSILON_RENDER_SCALE']);
 
 export const nativeLayer = new NativeLayer(width, height);
 
@@ -33,8 +54,8 @@ button2.loadFile('public/assets/button-up.png');
 
 //  const buttonTexture = (Math.floor(time()) % 2 == 0) ? button1 : button2;
 
+// Allocated in layout()
 const fbTexture = new nat.Texture();
-fbTexture.makeBlank(width, height);
 fbTexture.bind(TextureUnit.FB);
 
 const textPageTexture = new nat.Texture();
@@ -46,29 +67,32 @@ fontTexture.loadFile('public/assets/vga.png');
 fontTexture.bind(TextureUnit.FONT);
 
 const fb = new nat.Framebuffer();
-fb.setOutputTexture(fbTexture.textureId());
 fb.unbind();
 
-const programText = new nat.Program(shader.vertexFlip, shader.fragText);
+// Prefer the variant of the text shader with the grid size and palette
+// baked in at build time (see src/ui/gen-native.ts). This throws if the
+// native layer was built against different constants, rather than
+// drawing with stale ones.
+const bakedFragText = nat.getShaderVariant('fragText', configHash());
+const programText = new nat.Program(shader.vertexFlip, bakedFragText ?? shader.fragText);
 nativeLayer.configShaders(programText.programId());
+// The text pass always covers the whole framebuffer, whatever its size
 nat.glUniform2f(programText.getUniformLocation("u_offset"), 0, 0);
-nat.glUniform2f(programText.getUniformLocation("u_size"), width, height);
-nat.glUniform2f(programText.getUniformLocation("u_viewport_size"), width, height);
-nat.glUniform2f(programText.getUniformLocation("u_canvasSize"), screen_width, screen_height);
+nat.glUniform2f(programText.getUniformLocation("u_size"), 1, 1);
+nat.glUniform2f(programText.getUniformLocation("u_viewport_size"), 1, 1);
 nat.glUniform1i(programText.getUniformLocation("u_fontTexture"), TextureUnit.FONT);
 nat.glUniform1i(programText.getUniformLocation("u_textPageTexture"), TextureUnit.TEXT_PAGE);
-nat.glUniform4fv(programText.getUniformLocation("u_palette"), palette.paletteDataFloat());
+if (bakedFragText == null) {
+  nat.glUniform2f(programText.getUniformLocation("u_canvasSize"), screen_width, screen_height);
+  nat.glUniform4fv(programText.getUniformLocation("u_palette"), palette.paletteDataFloat());
+}
 
 export function updateTextPage(screen: Screen) {
-  nat.glActiveTexture(TextureUnit.TEXT_PAGE);
-  nat.glTexImage2d(COLS, ROWS, screen.imdat.data);
+  textPageTexture.setPixels(COLS, ROWS, screen.imdat.data);
 }
 
 const programSynth = new nat.Program(shader.vertex, shader.fragmentSynthetic);
 nativeLayer.configShaders(programSynth.programId());
-nat.glUniform2f(programSynth.getUniformLocation("u_offset"), 0, 0);
-nat.glUniform2f(programSynth.getUniformLocation("u_size"), width, height);
-nat.glUniform2f(programSynth.getUniformLocation("u_viewport_size"), width, height);
 
 const programTexture = new nat.Program(shader.vertex, shader.fragmentTexture);
 nativeLayer.configShaders(programTexture.programId());
@@ -78,12 +102,37 @@ const u_sampler = programTexture.getUniformLocation('u_sampler');
 
 const programPost = new nat.Program(shader.vertexFlip, shader.fragPost);
 nativeLayer.configShaders(programPost.programId());
-nat.glUniform2f(programPost.getUniformLocation("u_offset"), (width - screen_width) / 2, (height - screen_height) / 2);
 nat.glUniform2f(programPost.getUniformLocation("u_size"), screen_width, screen_height);
-nat.glUniform2f(programPost.getUniformLocation("u_viewport_size"), width, height);
 nat.glUniform1i(programPost.getUniformLocation("u_screenTexture"), TextureUnit.FB);
 nat.glUniform2f(programPost.getUniformLocation("windowSize"), screen_width, screen_height);
 
+// Sizes everything that depends on the window. Uniforms are in screen
+// coordinates, and the native layer maps them onto however many pixels
+// the window actually has; only the framebuffer needs to know about
+// pixel density.
+function layout(size: WindowSize) {
+  width = size.width;
+  height = size.height;
+
+  const pixelRatio = size.drawableWidth / size.width;
+  const fbWidth = Math.max(1, Math.round(screen_width * RENDER_SCALE * pixelRatio));
+  const fbHeight = Math.max(1, Math.round(screen_height * RENDER_SCALE * pixelRatio));
+  fbTexture.makeBlank(fbWidth, fbHeight);
+  fb.setOutputTexture(fbTexture.textureId(), fbWidth, fbHeight);
+  fb.unbind();
+
+  programSynth.use();
+  nat.glUniform2f(programSynth.getUniformLocation("u_offset"), 0, 0);
+  nat.glUniform2f(programSynth.getUniformLocation("u_size"), width, height);
+  nat.glUniform2f(programSynth.getUniformLocation("u_viewport_size"), width, height);
+
+  programPost.use();
+  nat.glUniform2f(programPost.getUniformLocation("u_offset"), (width - screen_width) / 2, (height - screen_height) / 2);
+  nat.glUniform2f(programPost.getUniformLocation("u_viewport_size"), width, height);
+}
+
+layout(nativeLayer.windowSize());
+
 const progStart = Date.now();
 function time(): number {
   return (Date.now() - progStart) / 1000;
@@ -92,6 +141,11 @@ function time(): number {
 // XXX do the same optimization I do in gl-pane where I don't even
 // draw the framebuffer if I don't need to.
 export function paintFrame(drawParams: DrawParams) {
+  const size = nativeLayer.pollResize();
+  if (size != null) {
+    layout(size);
+  }
+
   nativeLayer.clear();
 
   // Draw underlying screen data to framebuffer
@@ -7,24 +7,11 @@ import { Screen } from '../../src/ui/screen';
 import { logger } from '../../src/util/debug';
 import { produce } from '../../src/util/produce';
 import { nativeLayer, paintFrame, updateTextPage } from './graphics';
-import { initSounds } from './audio';
+import { initSounds, startAmbient } from './audio';
+import { convertSdlKey, installNativePaths, nextWake } from './loop';
 import * as nat from 'native-layer';
 import { AllSounds } from '../../src/ui/synth';
 
-function nextWake(state: GameState): WakeTime {
-  // XXX we could check times and be more optimal here
-  if (Object.keys(state.recurring).length > 0) {
-    return { t: 'live' };
-  }
-
-  if (state.futures.length > 0) {
-    if (state.futures.some(x => x.live))
-      return { t: 'live' };
-    return { t: 'tick', tick: state.futures[0].whenTicks };
-  }
-  return { t: 'infinite' };
-}
-
 function reschedule(dispatch: (a: Action) => void, state: GameState): ClockState {
   let { clock } = state;
   if (clock.timeoutId) {
@@ -64,9 +51,12 @@ function equalWake(a: WakeTime, b: WakeTime): boolean {
   }
 }
 
+installNativePaths();
+
 // Globals
 const state: State[] = [mkState()];
 let allSounds: undefined | AllSounds<nat.Sample> = undefined;
+let ambient: undefined | nat.Stream = undefined;
 
 function maybeRescheduleGame(priorState: GameState, state: GameState): GameState {
   if (!equalWake(nextWake(priorState), nextWake(state))) {
@@ -130,15 +120,14 @@ function repaint() {
   paintFrame(drawParamsOfState(state[0]));
 }
 
-function convertSdlKey(key: string): string {
-  const lower = key.toLowerCase();
-  return lower.length == 1 ? lower : `<${lower}>`;
-}
-
 function mainLoop() {
   const key = nativeLayer.pollEvent();
   if (key != null) {
     if (key == 'Q' || key == 'Escape') {
+      const recorded = nativeLayer.stopRecording();
+      if (recorded != null) {
+        console.log(`recorded ${recorded} events`);
+      }
       nativeLayer.finish();
       return;
     }
@@ -158,8 +147,18 @@ function mainLoop() {
 }
 
 function startup() {
+  // Set UPSILON_RECORD=path to log input for replay.ts
+  const recordPath = process.env['UPSILON_RECORD'];
+  if (recordPath) {
+    nativeLayer.startRecording(recordPath);
+  }
   nat.initSound();
   allSounds = initSounds();
+  // Set UPSILON_AMBIENT=path to loop a wav file in the background
+  const ambientPath = process.env['UPSILON_AMBIENT'];
+  if (ambientPath) {
+    ambient = startAmbient(ambientPath);
+  }
   mainLoop();
 }
 
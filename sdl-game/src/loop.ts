@@ -0,0 +1,47 @@
+import * as nat from 'native-layer';
+import { WakeTime } from '../../src/core/clock';
+import { compiledPrograms, setExecBatchRunner } from '../../src/core/exec-batch';
+import { GameState } from '../../src/core/model';
+import { setVirtualPlanner, virtualGenConfig } from '../../src/fs/vfs';
+import { setTagLayout, tagLayoutConfig } from '../../src/ui/tag-layout';
+
+// Pieces of the main loop shared between the game proper (index.ts)
+// and the replay harness (replay.ts)
+
+export function nextWake(state: GameState): WakeTime {
+  // XXX we could check times and be more optimal here
+  if (Object.keys(state.recurring).length > 0) {
+    return { t: 'live' };
+  }
+
+  if (state.futures.length > 0) {
+    if (state.futures.some(x => x.live))
+      return { t: 'live' };
+    return { t: 'tick', tick: state.futures[0].whenTicks };
+  }
+  return { t: 'infinite' };
+}
+
+export function convertSdlKey(key: string): string {
+  const lower = key.toLowerCase();
+  return lower.length == 1 ? lower : `<${lower}>`;
+}
+
+// Swaps in native-layer for the parts of src/ that have a native
+// version: generating the virtual filesystem, running batches of
+// executions, and laying out tag strings. Call it before making any
+// state. Set UPSILON_NO_NATIVE to leave the typescript versions in
+// place, e.g. to compare the two with replay.ts.
+export function installNativePaths(): void {
+  if (process.env['UPSILON_NO_NATIVE'] != undefined)
+    return;
+
+  const virtualGen = new nat.VirtualGen(virtualGenConfig(), 4096);
+  setVirtualPlanner(paths => virtualGen.plans(paths));
+
+  const execEngine = new nat.ExecEngine(compiledPrograms());
+  setExecBatchRunner((items, steps) => execEngine.run(items, steps));
+
+  const tagLayout = new nat.TagLayout(tagLayoutConfig(), 4096);
+  setTagLayout((data, state, str, attr, len) => tagLayout.draw(data, state, str, attr, len));
+}
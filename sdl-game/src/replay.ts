@@ -0,0 +1,157 @@
+// Replays an input log recorded with UPSILON_RECORD=path as a
+// macro-benchmark of the game loop. Usage:
+//
+//   node sdl-game/out/sdl-game/src/replay.js path [--realtime] [--render]
+//
+// By default events are fed in as fast as possible and nothing is
+// drawn; --realtime waits out the recorded gaps between events, and
+// --render opens a window and paints every frame as the game would.
+//
+// Game time is virtual: Date.now is replaced with a clock that jumps
+// to each event's recorded timestamp, and clock updates are dispatched
+// at exactly the ticks the game would have woken up at. So a replay
+// goes through the same sequence of states no matter how fast the
+// machine is.
+//
+// The native versions of the virtual filesystem, execution batches and
+// tag layout are used as in the game; run with UPSILON_NO_NATIVE set
+// to time the typescript ones instead.
+
+import * as nat from 'native-layer';
+import { clockedNextWake, MILLISECONDS_PER_TICK } from '../../src/core/clock';
+import { Action, mkState, State } from '../../src/core/model';
+import { reduce } from '../../src/core/reduce';
+import { animatePowerState, drawParamsOfState } from '../../src/ui/draw-params';
+import { render } from '../../src/ui/render';
+import { produce } from '../../src/util/produce';
+import { convertSdlKey, installNativePaths, nextWake } from './loop';
+
+const args = process.argv.slice(2);
+const path = args.find(x => !x.startsWith('--'));
+const realtime = args.includes('--realtime');
+const headless = !args.includes('--render');
+
+if (path == undefined) {
+  console.error('usage: replay.js path [--realtime] [--render]');
+  process.exit(1);
+}
+
+const realNow = Date.now;
+const startMs = realNow();
+let virtualNow = startMs;
+Date.now = () => virtualNow;
+
+// Only loaded if we're actually drawing, since it opens a window
+const graphics: typeof import('./graphics') | undefined =
+  headless ? undefined : require('./graphics');
+
+// Latency histograms, one per action type, with power-of-two buckets
+// in microseconds.
+const NUM_BUCKETS = 24;
+type Histogram = { counts: number[], samples: number[] };
+const histograms: Record<string, Histogram> = {};
+
+function recordLatency(t: string, us: number) {
+  if (histograms[t] == undefined) {
+    histograms[t] = { counts: new Array(NUM_BUCKETS).fill(0), samples: [] };
+  }
+  const h = histograms[t];
+  const bucket = Math.min(NUM_BUCKETS - 1, Math.max(0, Math.ceil(Math.log2(us + 1))));
+  h.counts[bucket]++;
+  h.samples.push(us);
+}
+
+function sleepUntil(offsetMs: number) {
+  if (!realtime)
+    return;
+  const delay = startMs + offsetMs - realNow();
+  if (delay > 0) {
+    Atomics.wait(new Int32Array(new SharedArrayBuffer(4)), 0, 0, delay);
+  }
+}
+
+// Time what the game runs, unless UPSILON_NO_NATIVE is set
+installNativePaths();
+
+let state: State = mkState();
+let numActions = 0;
+
+// Runs one action through reduce, render, and, if we have a window,
+// paintFrame, timing the whole thing.
+function step(action: Action) {
+  const before = process.hrtime.bigint();
+
+  const [sceneState, _effects] = reduce(state.sceneState, action);
+  state = produce(state, s => { s.sceneState = sceneState; });
+  const screen = render(state.sceneState);
+  if (graphics != undefined) {
+    graphics.updateTextPage(screen);
+    state = animatePowerState(state);
+    graphics.paintFrame(drawParamsOfState(state));
+  }
+
+  const us = Number(process.hrtime.bigint() - before) / 1000;
+  recordLatency(action.t, us);
+  numActions++;
+}
+
+// Dispatches every clock update that would have happened before
+// offsetMs into the recording.
+function advanceClock(offsetMs: number) {
+  const targetMs = startMs + offsetMs;
+  while (true) {
+    const gameState = state.sceneState.gameState;
+    const tick = clockedNextWake(gameState.clock, nextWake(gameState));
+    if (tick == Infinity)
+      break;
+    const wakeMs = gameState.clock.originEpochMs + tick * MILLISECONDS_PER_TICK;
+    if (wakeMs > targetMs)
+      break;
+    virtualNow = Math.max(virtualNow, wakeMs);
+    sleepUntil(virtualNow - startMs);
+    step({ t: 'clockUpdate', tick });
+  }
+  virtualNow = targetMs;
+  sleepUntil(offsetMs);
+}
+
+function report(elapsedMs: number, numEvents: number) {
+  console.log(`replayed ${numEvents} events as ${numActions} actions in ${elapsedMs.toFixed(1)}ms`);
+  console.log(`${(numActions / (elapsedMs / 1000)).toFixed(1)} actions/sec`);
+  Object.keys(histograms).sort().forEach(t => {
+    const { counts, samples } = histograms[t];
+    samples.sort((a, b) => a - b);
+    const pct = (p: number) => samples[Math.min(samples.length - 1, Math.floor(p * samples.length))].toFixed(1);
+    console.log(`\n${t}: n=${samples.length} p50=${pct(0.5)}us p90=${pct(0.9)}us p99=${pct(0.99)}us max=${pct(1)}us`);
+    const maxCount = Math.max(...counts);
+    counts.forEach((count, i) => {
+      if (count == 0)
+        return;
+      const bar = '#'.repeat(Math.ceil(40 * count / maxCount));
+      console.log(`  <${String(2 ** i).padStart(8)}us ${String(count).padStart(7)} ${bar}`);
+    });
+  });
+}
+
+function replay() {
+  const log = new nat.EventReplay(path!);
+  const before = realNow();
+  let numEvents = 0;
+  let event;
+  while ((event = log.next()) != null) {
+    numEvents++;
+    advanceClock(event.t);
+    const { key } = event;
+    if (key == 'Q' || key == 'Escape') {
+      break;
+    }
+    if (key == '1') {
+      step({ t: 'boot' });
+    }
+    step({ t: 'key', code: convertSdlKey(key) });
+  }
+  report(realNow() - before, numEvents);
+  graphics?.nativeLayer.finish();
+}
+
+replay();
@@ -0,0 +1,343 @@
+import { getLocation, modifyItem_imp } from "../fs/fs";
+import { getResource } from "../fs/resources";
+import { produce } from "../util/produce";
+import { nowTicks } from "./clock";
+import { executableProperties, ExecutableName, executables, getTargetsFor, isExecutable, isRecurring, modificationOrder, numTargetsOfExecutableName, scheduleRecur_imp } from "./executables";
+import { Acl, Effect, GameAction, GameState, Ident, Location } from "./model";
+import { addFuture_imp, reduceGameState, ReduceResult } from "./reduce";
+
+// A clock tick can have a lot of executables come due at once, and
+// running each through reduceGameState costs a few full copies of the
+// state apiece. Most of what automation does, though, is shuffle cpu
+// around and flip acls, which we can compile to a little bytecode and
+// run over a flat table of just those numbers. This runs every such
+// execution due in a tick as one batch and applies the results in a
+// single produce. Anything else goes through reduceGameState as
+// before, in order.
+
+// Instructions are four numbers, [op, a, b, c]. Targets are numbered
+// by their position in the executable's argument list.
+export enum ExecOp {
+  // cpu of target a += b
+  addCpu = 1,
+  // moves min(c, cpu of target a) cpu from target a to target b
+  movCpu,
+  // flips acl bit b of target a
+  toggleAcl,
+  // stops the batch here unless target a has any of acl bits b, or the
+  // actor has any of acl bits c
+  require,
+}
+
+export const INSTR_SIZE = 4;
+
+export type CompiledExecutable = {
+  cycles: number,
+  cpuCost: number,
+  numTargets: number,
+  code: number[],
+};
+
+// Bits of an item's acls in the batch's item table
+const ACL_BITS: Acl[] = ['open', 'pickup', 'exec', 'instr', 'unlock'];
+
+function aclBit(acl: Acl): number {
+  return 1 << ACL_BITS.indexOf(acl);
+}
+
+// The item table has ITEM_SIZE numbers per item: cpu, acl bits, and
+// which of those the batch wrote to (TOUCHED_CPU, or TOUCHED_ACL
+// shifted by the acl's bit index).
+export const ITEM_SIZE = 3;
+export const TOUCHED_CPU = 1;
+export const TOUCHED_ACL = 2;
+
+// The step table has STEP_SIZE numbers per step: kind, program (the
+// index in modificationOrder), actor, and up to MAX_TARGETS targets,
+// with the last three being indices into the item table, or -1.
+export const STEP_SIZE = 5;
+export const MAX_TARGETS = 2;
+
+export enum StepKind {
+  // Pays the executable's cpu cost, as for a 'recur' action
+  start = 0,
+  // Runs the executable, as for a 'finishExecution' action
+  finish = 1,
+}
+
+export function compileExecutable(name: ExecutableName): CompiledExecutable | undefined {
+  const { cycles, cpuCost, aclRequirements } = executableProperties[name];
+  const numTargets = numTargetsOfExecutableName(name);
+
+  // Zero-cycle executables finish inside startExecutable, which we
+  // don't batch.
+  if (cycles == 0 || numTargets < 0 || numTargets > MAX_TARGETS)
+    return undefined;
+
+  const toggle = (acl: Acl) => [ExecOp.toggleAcl, 0, ACL_BITS.indexOf(acl), 0];
+  let body: number[];
+  switch (name) {
+    case executables.combine: body = []; break;
+    case executables.movCpu5: body = [ExecOp.movCpu, 0, 1, 5]; break;
+    case executables.movCpu1: body = [ExecOp.movCpu, 0, 1, 1]; break;
+    case executables.charge: body = [ExecOp.addCpu, 0, 1, 0]; break;
+    case executables.treadmill: body = [ExecOp.addCpu, 0, 1, 0]; break;
+    case executables.toggleOpen: body = toggle('open'); break;
+    case executables.togglePickup: body = toggle('pickup'); break;
+    case executables.toggleInstr: body = toggle('instr'); break;
+    case executables.toggleExec: body = toggle('exec'); break;
+    case executables.toggleUnlock: body = toggle('unlock'); break;
+    default: return undefined;
+  }
+
+  // Same as satisfiesAclRequirements
+  const checks: number[] = [];
+  for (let i = 0; i < numTargets; i++) {
+    if (((aclRequirements ?? [])[i] ?? 'write') == 'write') {
+      checks.push(ExecOp.require, i, aclBit('pickup'), aclBit('unlock'));
+    }
+  }
+  return { cycles, cpuCost, numTargets, code: [...checks, ...body] };
+}
+
+let _compiledPrograms: (CompiledExecutable | null)[] | undefined = undefined;
+
+// Indexed like modificationOrder(); null for executables that have to
+// go through reduceGameState.
+export function compiledPrograms(): (CompiledExecutable | null)[] {
+  if (_compiledPrograms == undefined) {
+    _compiledPrograms = modificationOrder().map(name => compileExecutable(name) ?? null);
+  }
+  return _compiledPrograms;
+}
+
+// Runs steps in order, updating items in place. Returns how many steps
+// ran; if that's less than all of them, the next one would have failed
+// and hasn't changed anything.
+export type ExecBatchRunner = (items: Float64Array, steps: Int32Array) => number;
+
+export function runExecBatch(programs: (CompiledExecutable | null)[], items: Float64Array, steps: Int32Array): number {
+  const numSteps = steps.length / STEP_SIZE;
+  for (let i = 0; i < numSteps; i++) {
+    const step = i * STEP_SIZE;
+    const program = programs[steps[step + 1]]!;
+    const actor = steps[step + 2] * ITEM_SIZE;
+    const target = (t: number) => steps[step + 3 + t] * ITEM_SIZE;
+
+    if (steps[step] == StepKind.start) {
+      if (items[actor] < program.cpuCost)
+        return i;
+      items[actor] -= program.cpuCost;
+      items[actor + 2] |= TOUCHED_CPU;
+      continue;
+    }
+
+    const code = program.code;
+    for (let pc = 0; pc < code.length; pc += INSTR_SIZE) {
+      if (code[pc] == ExecOp.require
+        && !(items[target(code[pc + 1]) + 1] & code[pc + 2])
+        && !(items[actor + 1] & code[pc + 3]))
+        return i;
+    }
+    for (let pc = 0; pc < code.length; pc += INSTR_SIZE) {
+      const a = code[pc + 1], b = code[pc + 2], c = code[pc + 3];
+      switch (code[pc]) {
+        case ExecOp.addCpu:
+          items[target(a)] += b;
+          items[target(a) + 2] |= TOUCHED_CPU;
+          break;
+        case ExecOp.movCpu: {
+          const amount = Math.min(c, items[target(a)]);
+          items[target(a)] -= amount;
+          items[target(b)] += amount;
+          items[target(a) + 2] |= TOUCHED_CPU;
+          items[target(b) + 2] |= TOUCHED_CPU;
+          break;
+        }
+        case ExecOp.toggleAcl:
+          items[target(a) + 1] ^= 1 << b;
+          items[target(a) + 2] |= TOUCHED_ACL << b;
+          break;
+      }
+    }
+  }
+  return numSteps;
+}
+
+let runner: ExecBatchRunner = (items, steps) => runExecBatch(compiledPrograms(), items, steps);
+
+// The native game installs one from native-layer
+export function setExecBatchRunner(r: ExecBatchRunner): void {
+  runner = r;
+}
+
+type BatchStep = {
+  kind: StepKind,
+  name: ExecutableName,
+  actorId: Ident,
+  targetIds: Ident[],
+  loc: Location,
+};
+
+type Batch = {
+  idents: Ident[],
+  items: number[],
+  steps: BatchStep[],
+  stepData: number[],
+  // Index into the actions of each step's action
+  actionIxs: number[],
+  // Index of the first action not in the batch
+  end: number,
+};
+
+// Only items that are already real, rather than virtual items that
+// haven't been modified yet, since those need reifying.
+function slotOf(state: GameState, batch: Batch, slots: Map<Ident, number>, ident: Ident): number | undefined {
+  const slot = slots.get(ident);
+  if (slot != undefined)
+    return slot;
+  const item = state.fs.idToItem[ident];
+  if (item == undefined)
+    return undefined;
+  const acls = ACL_BITS.reduce((bits, acl, i) => bits | (item.acls[acl] ? 1 << i : 0), 0);
+  slots.set(ident, batch.idents.length);
+  batch.idents.push(ident);
+  batch.items.push(getResource(item, 'cpu'), acls, 0);
+  return batch.idents.length - 1;
+}
+
+function stepOfAction(state: GameState, action: GameAction): BatchStep | 'skip' | undefined {
+  const programs = compiledPrograms();
+  const order = modificationOrder();
+  switch (action.t) {
+    case 'finishExecution': {
+      if (programs[order.indexOf(action.instr)] == null)
+        return undefined;
+      const loc = getLocation(state.fs, action.actorId);
+      const targetIds = getTargetsFor(state.fs, loc, action.instr);
+      if (targetIds == undefined)
+        return undefined;
+      return { kind: StepKind.finish, name: action.instr, actorId: action.actorId, targetIds, loc };
+    }
+    case 'recur': {
+      const actor = state.fs.idToItem[action.ident];
+      if (actor == undefined || !isExecutable(actor.name) || programs[order.indexOf(actor.name)] == null)
+        return undefined;
+      const loc = getLocation(state.fs, action.ident);
+      return { kind: StepKind.start, name: actor.name, actorId: action.ident, targetIds: [], loc };
+    }
+    // Does nothing in reduceGameState either
+    case 'none': return 'skip';
+    default: return undefined;
+  }
+}
+
+// Collects the batchable actions starting at actions[start]
+function gatherBatch(state: GameState, actions: GameAction[], start: number): Batch {
+  const batch: Batch = { idents: [], items: [], steps: [], stepData: [], actionIxs: [], end: start };
+  const slots = new Map<Ident, number>();
+  const order = modificationOrder();
+  for (; batch.end < actions.length; batch.end++) {
+    const step = stepOfAction(state, actions[batch.end]);
+    if (step == 'skip')
+      continue;
+    if (step == undefined)
+      break;
+    const actorSlot = slotOf(state, batch, slots, step.actorId);
+    const targetSlots = step.targetIds.map(id => slotOf(state, batch, slots, id));
+    if (actorSlot == undefined || targetSlots.some(slot => slot == undefined))
+      break;
+    batch.steps.push(step);
+    batch.actionIxs.push(batch.end);
+    batch.stepData.push(step.kind, order.indexOf(step.name), actorSlot);
+    for (let t = 0; t < MAX_TARGETS; t++) {
+      batch.stepData.push(targetSlots[t] ?? -1);
+    }
+  }
+  return batch;
+}
+
+// Does everything reduceGameState would have for the first numDone
+// steps, given the item table they left behind.
+function applyBatch(state: GameState, batch: Batch, items: Float64Array, numDone: number): ReduceResult {
+  const now = nowTicks(state.clock);
+  const effects: Effect[] = [];
+  state = produce(state, s => {
+    batch.idents.forEach((ident, slot) => {
+      const base = slot * ITEM_SIZE;
+      const touched = items[base + 2];
+      if (touched == 0)
+        return;
+      modifyItem_imp(s.fs, ident, item => {
+        if (touched & TOUCHED_CPU) {
+          item.resources.cpu = items[base];
+        }
+        ACL_BITS.forEach((acl, i) => {
+          if (touched & (TOUCHED_ACL << i)) {
+            item.acls[acl] = !!(items[base + 1] & (1 << i));
+          }
+        });
+      });
+    });
+
+    for (const step of batch.steps.slice(0, numDone)) {
+      switch (step.kind) {
+        case StepKind.finish:
+          if (step.targetIds.length > 0)
+            addFuture_imp(s, now + 1, { t: 'none' }, true);
+          step.targetIds.forEach(id => {
+            modifyItem_imp(s.fs, id, item => { item.flashUntilTick = now + 1; });
+          });
+          modifyItem_imp(s.fs, step.actorId, item => { item.progress = undefined; });
+          if (isRecurring(s, step.actorId)) {
+            scheduleRecur_imp(s, step.actorId);
+          }
+          effects.push({ t: 'playAbstractSound', effect: 'success', loc: step.loc });
+          break;
+        case StepKind.start: {
+          const { cycles } = executableProperties[step.name];
+          modifyItem_imp(s.fs, step.actorId, item => {
+            item.progress = { startTicks: now, totalTicks: cycles };
+          });
+          addFuture_imp(s, now + cycles, { t: 'finishExecution', actorId: step.actorId, instr: step.name }, true);
+          effects.push({ t: 'playAbstractSound', effect: 'execute', loc: step.loc });
+          break;
+        }
+      }
+    }
+  });
+  return [state, effects];
+}
+
+// Equivalent to reducing each of actions in turn with reduceGameState
+export function reduceDueActions(state: GameState, actions: GameAction[]): ReduceResult {
+  let effects: Effect[] = [];
+  let i = 0;
+  while (i < actions.length) {
+    const batch = gatherBatch(state, actions, i);
+    let moreEffects: Effect[];
+    if (batch.steps.length > 0) {
+      const items = new Float64Array(batch.items);
+      const numDone = runner(items, new Int32Array(batch.stepData));
+      [state, moreEffects] = applyBatch(state, batch, items, numDone);
+      effects = [...effects, ...moreEffects];
+      if (numDone < batch.steps.length) {
+        // The batch stopped because this one would fail, so let the
+        // usual path report it.
+        i = batch.actionIxs[numDone];
+      }
+      else {
+        i = batch.end;
+        continue;
+      }
+    }
+    else if (batch.end > i) {
+      i = batch.end;
+      continue;
+    }
+    [state, moreEffects] = reduceGameState(state, actions[i]);
+    effects = [...effects, ...moreEffects];
+    i++;
+  }
+  return [state, effects];
+}
@@ -160,7 +160,7 @@ export function cancelRecur_imp(state: GameState, ident: Ident) {
   delete state.recurring[ident];
 }
 
-function getTargetsFor(fs: Fs, loc: Location, instr: ExecutableName): Ident[] | undefined {
+export function getTargetsFor(fs: Fs, loc: Location, instr: ExecutableName): Ident[] | undefined {
   const numTargets = numTargetsOfExecutableName(instr);
   const absNumTargets = Math.abs(numTargets);
   if (numTargets < 0) {
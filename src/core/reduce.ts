@@ -5,6 +5,7 @@ import { nowTicks } from './clock';
 import { ConfigureViewState, putItemConfig, reduceConfigureView } from './configure';
 import { ErrorCode, ErrorInfo } from './errors';
 import { cancelRecur_imp, executeInstructions, isExecutable, isRecurring, scheduleRecur_imp, startExecutable, tryStartExecutable } from './executables';
+import { reduceDueActions } from './exec-batch';
 import { enumsOfFs, errorsOfFs, Hook, keybindingsOfFs, showOfFs, soundsOfFs } from './hooks';
 import { DropLineAction, ExecLineAction, PickupLineAction, SignalAction } from './lines';
 import { isLinLog, startLinlog } from './linlog';
@@ -269,16 +270,6 @@ function reduceDropAction(state: GameState, action: DropLineAction): ReduceResul
   }
 }
 
-function reduceActions(state: GameState, actions: GameAction[]): ReduceResult {
-  let effects: Effect[] = [];
-  for (const action of actions) {
-    let moreEffects;
-    [state, moreEffects] = reduceGameState(state, action);
-    effects = [...effects, ...moreEffects];
-  }
-  return [state, effects];
-}
-
 function actionOfKey(state: GameState, code: string): KeyAction {
   return state._cached_keybindings[code] ?? { t: 'other', code };
 }
@@ -386,7 +377,7 @@ export function reduceGameState(state: GameState, action: GameAction): ReduceRes
         // XXX Might want to think about doing something smarter if I
         // have effects that are intended to be idempotent (even
         // though I don't think I do right now)
-        return noError(reduceActions(state, actions));
+        return noError(reduceDueActions(state, actions));
       }
       else {
         return [state, [], undefined];
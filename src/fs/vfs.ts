@@ -1,5 +1,6 @@
 import { Ident, Item, Location } from '../core/model';
 import { translit } from '../util/alphabet';
+import { Lru } from '../util/lru';
 import { Rand } from '../util/util';
 import { Fs, itemOfPlan, ItemPlan, virtualId } from "./fs";
 import { Resources } from './resources';
@@ -20,10 +21,66 @@ export const VIRTUAL_ITEM_PREFIX = '_gen_';
 // _gen_vroot/foo1/foo3
 // etc.
 
-type VirtualItemPlan =
+export type VirtualItemPlan =
   | { t: 'file', name: string }
   | { t: 'dir', name: string, contents: Ident[] };
 
+// Every generated directory has this many subdirectories, with ids
+// dir-0 through dir-(DIR_ID_RANGE - 1)
+const DIR_FANOUT = 5;
+const DIR_ID_RANGE = 1000;
+
+// Directories with seed below the bound also contain the file
+function specialFiles(): [number, Ident][] {
+  return [
+    [100, translit('tapra')],
+    [200, translit('gar')],
+    [300, translit('wojma')],
+  ];
+}
+
+// Everything a generator other than the one in this file needs to
+// know to produce the same plans.
+export type VirtualGenConfig = {
+  surnames: string[],
+  fanout: number,
+  idRange: number,
+  specials: [number, Ident][],
+};
+
+export function virtualGenConfig(): VirtualGenConfig {
+  return {
+    surnames: getAssets().surnames,
+    fanout: DIR_FANOUT,
+    idRange: DIR_ID_RANGE,
+    specials: specialFiles(),
+  };
+}
+
+// Takes a batch of virtual idents (paths like vroot/dir-1/dir-2) to
+// their plans. The native game installs one from native-layer;
+// otherwise we use this one.
+export type VirtualPlanner = (paths: Ident[]) => VirtualItemPlan[];
+
+export function virtualPlans(paths: Ident[]): VirtualItemPlan[] {
+  return paths.map(path => virtualPlanOfIdent(path.split('/').pop()!));
+}
+
+let planner: VirtualPlanner = virtualPlans;
+
+// Browsing the virtual filesystem looks up the same few items over
+// and over, so keep the recently generated ones around. Callers get
+// their own copy, since they go on to modify and reify it.
+const CACHE_SIZE = 4096;
+const planCache = new Lru<Ident, VirtualItemPlan>(CACHE_SIZE);
+const itemCache = new Lru<Ident, Item>(CACHE_SIZE);
+
+export function setVirtualPlanner(p: VirtualPlanner): void {
+  planner = p;
+  planCache.clear();
+  itemCache.clear();
+}
+
 function resourcesOfIdent(ident: Ident): Resources {
   switch (ident) {
     case translit('tapra'): return { cpu: 3 };
@@ -46,8 +103,37 @@ function planOfVirtualPlan(ident: Ident, vip: VirtualItemPlan): ItemPlan {
     }
   }
 }
+// Fresh copies of everything a virtual item can have that's mutable
+function copyVirtualItem(item: Item): Item {
+  const content = item.content.t == 'file'
+    ? { ...item.content, contents: [...item.content.contents] }
+    : item.content;
+  return { ...item, acls: { ...item.acls }, resources: { ...item.resources }, content };
+}
+
 export function getVirtualItem(ident: Ident): Item {
-  const plan = planOfVirtualPlan(ident, getVirtualItemPlan(ident))
+  const cached = itemCache.get(ident);
+  if (cached !== undefined) {
+    return copyVirtualItem(cached);
+  }
+  const vip = getVirtualItemPlan(ident);
+  const item = itemOfVirtualPlan(ident, vip);
+  itemCache.set(ident, item);
+
+  // Whoever asked for a directory is probably about to ask for
+  // everything in it, so generate that all in one go.
+  if (vip.t == 'dir') {
+    const paths = vip.contents.map(id => `${ident}/${id}`).filter(path => !itemCache.has(path));
+    planner(paths).forEach((childVip, i) => {
+      planCache.set(paths[i], childVip);
+      itemCache.set(paths[i], itemOfVirtualPlan(paths[i], childVip));
+    });
+  }
+  return copyVirtualItem(item);
+}
+
+function itemOfVirtualPlan(ident: Ident, vip: VirtualItemPlan): Item {
+  const plan = planOfVirtualPlan(ident, vip);
   const item = itemOfPlan(plan);
   // XXX I don't love this special case, but this is what I want out of a virtual item dir:
   // that it already knows its contents.
@@ -107,18 +193,13 @@ function virtualPlanOfIdent(ident: Ident): VirtualItemPlan {
 
     const rand = new Rand(seed);
     const contents: Ident[] = [];
-    for (let i = 0; i < 5; i++) {
-      const genid = rand.i(1000);
+    for (let i = 0; i < DIR_FANOUT; i++) {
+      const genid = rand.i(DIR_ID_RANGE);
       contents.push(`dir-${genid}`);
     }
-    if (seed < 100) {
-      contents.push(translit('tapra'));
-    }
-    else if (seed < 200) {
-      contents.push(translit('gar'));
-    }
-    else if (seed < 300) {
-      contents.push(translit('wojma'));
+    const special = specialFiles().find(([bound, _]) => seed! < bound);
+    if (special != undefined) {
+      contents.push(special[1]);
     }
     return { t: 'dir', name: nameOfIdent(ident), contents };
   }
@@ -128,7 +209,13 @@ function virtualPlanOfIdent(ident: Ident): VirtualItemPlan {
 }
 
 export function getVirtualItemPlan(path: Ident): VirtualItemPlan {
-  return virtualPlanOfIdent(path.split('/').pop()!);
+  const cached = planCache.get(path);
+  if (cached !== undefined) {
+    return cached;
+  }
+  const [vip] = planner([path]);
+  planCache.set(path, vip);
+  return vip;
 }
 
 export function getVirtualItemLocation(ident: Ident): Location {
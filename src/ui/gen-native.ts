@@ -0,0 +1,85 @@
+import * as fs from 'fs';
+import * as path from 'path';
+import { genConfig, screenSize } from './native-config';
+import { paletteDataFloat } from './palette';
+import { char_size, COLS, ROWS, SCALE, TEXT_PAGE_H, TEXT_PAGE_W } from './ui-constants';
+
+// Generates, into native-layer/src/gen,
+// - config.h, the ui constants and palette as C++ constexprs (see
+//   native-config.ts)
+// - shaders.h, shader variants with the same values baked in
+// so that none of it has to be duplicated by hand or sent to the gpu
+// as uniforms at runtime.
+
+const CONFIG_REGION = /\/\/ BEGIN CONFIG\n[^]*\/\/ END CONFIG\n/;
+
+const assetsDir = path.join(__dirname, '../public/assets');
+const outDir = path.join(__dirname, '../native-layer/src/gen');
+
+function glslFloat(n: number): string {
+  return Number.isInteger(n) ? `${n}.0` : `${n}`;
+}
+
+// Replaces the config region of fragText.frag with constants
+function bakeFragText(source: string): string {
+  if (!CONFIG_REGION.test(source)) {
+    throw new Error('fragText.frag has no config region');
+  }
+  const data = paletteDataFloat();
+  const colors: string[] = [];
+  for (let i = 0; i < data.length; i += 4) {
+    colors.push(`  vec4(${data.slice(i, i + 4).map(glslFloat).join(', ')})`);
+  }
+  const { x, y } = screenSize();
+  const baked = `// Baked in by src/ui/gen-native.ts. The uniforms keep their names so
+// the rest of the shader is the same either way.
+const vec2 u_canvasSize = vec2(${glslFloat(x)}, ${glslFloat(y)});
+
+const int ROWS = ${ROWS};
+const int COLS = ${COLS};
+const int TEXT_PAGE_W = ${TEXT_PAGE_W};
+const int TEXT_PAGE_H = ${TEXT_PAGE_H};
+
+const vec4 u_palette[16] = vec4[16](
+${colors.join(',\n')}
+);
+
+const ivec2 char_size = ivec2(${char_size.x}, ${char_size.y});
+
+int SCALE() {
+  return ${SCALE};
+}
+`;
+  return source.replace(CONFIG_REGION, baked);
+}
+
+function genShaders(): string {
+  const fragText = fs.readFileSync(path.join(assetsDir, 'fragText.frag'), 'utf8');
+  const variants: [string, string][] = [
+    ['fragText', bakeFragText(fragText)],
+  ];
+  const entries = variants.map(([name, source]) =>
+    `    {"${name}", R"glsl(${source})glsl"},`).join('\n');
+  return `#pragma once
+
+// Generated by src/ui/gen-native.ts from the shaders in public/assets,
+// specialized to the values in config.h. Don't edit.
+
+struct ShaderVariant {
+  const char *name;
+  const char *source;
+};
+
+constexpr ShaderVariant shader_variants[] = {
+${entries}
+};
+`;
+}
+
+function genNative() {
+  fs.mkdirSync(outDir, { recursive: true });
+  fs.writeFileSync(path.join(outDir, 'config.h'), genConfig(), 'utf8');
+  fs.writeFileSync(path.join(outDir, 'shaders.h'), genShaders(), 'utf8');
+}
+
+genNative();
@@ -0,0 +1,52 @@
+import { createHash } from 'crypto';
+import { paletteDataFloat } from './palette';
+import { char_size, COLS, ROWS, SCALE, TEXT_PAGE_H, TEXT_PAGE_W } from './ui-constants';
+
+// The ui constants native-layer is built against (see gen-native.ts),
+// and a hash of them so a stale build can be caught at runtime.
+
+export function screenSize(): { x: number, y: number } {
+  return { x: SCALE * COLS * char_size.x, y: SCALE * ROWS * char_size.y };
+}
+
+function configBody(): string {
+  const palette = paletteDataFloat().map(n => `    ${n},`).join('\n');
+  return `constexpr int ROWS = ${ROWS};
+constexpr int COLS = ${COLS};
+constexpr int TEXT_PAGE_W = ${TEXT_PAGE_W};
+constexpr int TEXT_PAGE_H = ${TEXT_PAGE_H};
+constexpr int CHAR_W = ${char_size.x};
+constexpr int CHAR_H = ${char_size.y};
+constexpr int SCALE = ${SCALE};
+constexpr int SCREEN_WIDTH = ${screenSize().x};
+constexpr int SCREEN_HEIGHT = ${screenSize().y};
+
+// rgba for each of the 16 color codes
+constexpr GLfloat palette[] = {
+${palette}
+};
+`;
+}
+
+// Changes whenever anything in config.h would
+export function configHash(): string {
+  return createHash('sha256').update(configBody()).digest('hex').slice(0, 16);
+}
+
+export function genConfig(): string {
+  return `#pragma once
+
+// Generated by src/ui/gen-native.ts from src/ui/ui-constants.ts and
+// src/ui/palette.ts. Don't edit.
+
+#include <SDL2/SDL_opengl.h>
+
+namespace config {
+
+// configHash() of everything below
+constexpr const char *HASH = "${configHash()}";
+
+${configBody()}
+} // namespace config
+`;
+}
@@ -1,8 +1,8 @@
 import { Char, COLS, ROWS, ColorCode, TEXT_PAGE_W, TEXT_PAGE_H } from './ui-constants';
 import { Point } from '../util/types';
 import { invertAttr, repeat } from '../util/util';
-import { parseTagstrSafe as parseTagstr } from './parse-tagstr';
 import { ImageDat } from './image-dat';
+import { getTagLayout, writeStr } from './tag-layout';
 
 export type Attr = { fg: ColorCode, bg: ColorCode };
 export type Rect = { x: number, y: number, w: number, h: number };
@@ -70,7 +70,7 @@ export const progressChars = [
 
 export const arrowChars = '\xa0\xa1\xa2\xa3';
 
-type StrState = {
+export type StrState = {
   start: Point,
   p: Point,
   wrapLen?: number
@@ -87,11 +87,11 @@ export function boxify(x: number): (charcode: number) => number {
   }
 }
 
-function codeOfAttr(attr: Attr): number {
+export function codeOfAttr(attr: Attr): number {
   return attr.fg + 16 * attr.bg;
 }
 
-function attrOfCode(code: number): Attr {
+export function attrOfCode(code: number): Attr {
   return { fg: code & 15, bg: (code >> 4) & 15 };
 }
 
@@ -167,28 +167,11 @@ export class Screen {
   }
 
   drawTagStr(state: StrState, str: string, attr: Attr) {
-    this.drawAttrStr(state, parseTagstr(str, attr));
+    getTagLayout()(this.imdat.data, state, str, codeOfAttr(attr), -1);
   }
 
   drawStr(state: StrState, str: string, attr: Attr): StrState {
-    for (let n = 0; n < str.length; n++) {
-      const cc = str.charCodeAt(n);
-      if (cc == 10) {
-        state.p.y++;
-        state.p.x = state.start.x;
-      }
-      else {
-        this.putChar(state.p.x, state.p.y, {
-          ...attr,
-          charcode: str.charCodeAt(n)
-        });
-        state.p.x++;
-        if (state.wrapLen !== undefined && state.p.x - state.start.x >= state.wrapLen) {
-          state.p.y++;
-          state.p.x = state.start.x;
-        }
-      }
-    }
+    writeStr(this.imdat.data, state, str, codeOfAttr(attr));
     return state;
   }
 
@@ -200,26 +183,9 @@ export class Screen {
     this.drawStr(state, padded, attr);
   }
 
-  parseStrToLength(str: string, attr: Attr, len: number): AttrString[] {
-    const parsed = parseTagstr(str, attr);
-    let total = 0;
-    for (let i = 0; i < parsed.length; i++) {
-      const nextTotal = total + parsed[i].str.length;
-      if (nextTotal > len) {
-        parsed[i].str = parsed[i].str.substr(str.length - (nextTotal - len));
-        parsed.splice(i + 1);
-        return parsed;
-      }
-      total = nextTotal;
-    }
-    // if we get here, len >= length(str)
-    const padding = len - total;
-    parsed.push({ str: repeat(' ', len - total), attr });
-    return parsed;
-  }
-
+  // Cut off or padded to exactly len characters
   drawTagLine(state: StrState, len: number, str: string, attr: Attr) {
-    this.drawAttrStr(state, this.parseStrToLength(str, attr, len));
+    getTagLayout()(this.imdat.data, state, str, codeOfAttr(attr), len);
   }
 
   fillRect(rect: Rect, attr: Attr, char: number) {
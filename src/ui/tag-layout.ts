@@ -0,0 +1,89 @@
+import { Lru } from '../util/lru';
+import { repeat } from '../util/util';
+import { parseTagstrSafe } from './parse-tagstr';
+import { attrOfCode, Chars, codeOfAttr, StrState } from './screen';
+import { ncolors, TEXT_PAGE_W } from './ui-constants';
+
+// render() draws the same item names and labels on every frame, so
+// instead of parsing their tags each time, we keep them parsed into
+// runs, keyed by the string and the attr it starts out in, and copy
+// the runs straight into the text page.
+
+export type TagLayoutConfig = {
+  colors: string[],
+  entities: [string, number][],
+};
+
+export function tagLayoutConfig(): TagLayoutConfig {
+  return {
+    colors: ncolors,
+    entities: Object.entries(Chars).map(([name, chr]) => [name, chr.charCodeAt(0)]),
+  };
+}
+
+// Draws str, with tags as in parseTagstr, into the text page data at
+// state.p, advancing it like Screen.drawStr. attr is a code as in
+// codeOfAttr. If len is nonnegative, the drawn text is cut off or
+// padded with spaces in attr to exactly len characters.
+export type TagLayout = (data: Uint8Array, state: StrState, str: string, attr: number, len: number) => void;
+
+type Run = { str: string, attr: number };
+
+const CACHE_SIZE = 4096;
+const runCache = new Lru<string, Run[]>(CACHE_SIZE);
+
+function runsOf(str: string, attr: number): Run[] {
+  const key = `${attr}:${str}`;
+  let runs = runCache.get(key);
+  if (runs == undefined) {
+    runs = parseTagstrSafe(str, attrOfCode(attr)).map(({ str, attr }) => ({ str, attr: codeOfAttr(attr) }));
+    runCache.set(key, runs);
+  }
+  return runs;
+}
+
+export function writeStr(data: Uint8Array, state: StrState, str: string, attr: number): void {
+  for (let n = 0; n < str.length; n++) {
+    const cc = str.charCodeAt(n);
+    if (cc == 10) {
+      state.p.y++;
+      state.p.x = state.start.x;
+    }
+    else {
+      const i = 4 * (state.p.y * TEXT_PAGE_W + state.p.x);
+      data[i] = cc;
+      data[i + 1] = attr;
+      state.p.x++;
+      if (state.wrapLen !== undefined && state.p.x - state.start.x >= state.wrapLen) {
+        state.p.y++;
+        state.p.x = state.start.x;
+      }
+    }
+  }
+}
+
+export function layoutTagStr(data: Uint8Array, state: StrState, str: string, attr: number, len: number): void {
+  let left = len < 0 ? Infinity : len;
+  for (const run of runsOf(str, attr)) {
+    if (run.str.length > left) {
+      writeStr(data, state, run.str.substr(0, left), run.attr);
+      return;
+    }
+    writeStr(data, state, run.str, run.attr);
+    left -= run.str.length;
+  }
+  if (left > 0 && left < Infinity) {
+    writeStr(data, state, repeat(' ', left), attr);
+  }
+}
+
+let layout: TagLayout = layoutTagStr;
+
+export function getTagLayout(): TagLayout {
+  return layout;
+}
+
+// The native game installs one from native-layer
+export function setTagLayout(l: TagLayout): void {
+  layout = l;
+}
@@ -1,7 +1,8 @@
 import { Point } from "../util/types";
 
-// These need to be the same values as those that occur in
-// public/assets/fragment.frag
+// These need to be the same values as those in the config section of
+// public/assets/fragText.frag, which the browser build uses as is. The
+// native build generates its copies from here; see gen-native.ts.
 export const SCALE = 3;
 export const ROWS = 18;
 export const COLS = 48;
@@ -0,0 +1,36 @@
+// A map with bounded size that forgets the least recently used entry
+// when it's full. Relies on Map iterating in insertion order.
+export class Lru<K, V> {
+  capacity: number;
+  map: Map<K, V> = new Map();
+
+  constructor(capacity: number) {
+    this.capacity = capacity;
+  }
+
+  get(k: K): V | undefined {
+    const v = this.map.get(k);
+    if (v !== undefined) {
+      this.map.delete(k);
+      this.map.set(k, v);
+    }
+    return v;
+  }
+
+  // Doesn't count as a use
+  has(k: K): boolean {
+    return this.map.has(k);
+  }
+
+  set(k: K, v: V): void {
+    this.map.delete(k);
+    this.map.set(k, v);
+    if (this.map.size > this.capacity) {
+      this.map.delete(this.map.keys().next().value);
+    }
+  }
+
+  clear(): void {
+    this.map.clear();
+  }
+}
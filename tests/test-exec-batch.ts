@@ -0,0 +1,62 @@
+import { reduceDueActions, runExecBatch, compiledPrograms, setExecBatchRunner } from '../src/core/exec-batch';
+import { Effect, GameAction, gameStateOfFs } from '../src/core/model';
+import { reduceGameState } from '../src/core/reduce';
+import { insertPlans, mkFs } from '../src/fs/fs';
+import { SpecialId } from '../src/fs/initial-fs';
+import { testFile } from "./testing-utils";
+
+const fs = (() => {
+  let fs = mkFs();
+  [fs,] = insertPlans(fs, SpecialId.root, [
+    testFile('charge', { cpu: 3 }),
+    testFile('battery'),
+    testFile('mov-cpu-1'),
+    testFile('source', { cpu: 2 }),
+    testFile('sink'),
+    testFile('toggle-pickup'),
+    testFile('victim'),
+  ]);
+  return fs;
+})();
+
+const actions: GameAction[] = [
+  { t: 'finishExecution', actorId: 'charge', instr: 'charge' },
+  { t: 'none' },
+  { t: 'recur', ident: 'charge' },
+  { t: 'finishExecution', actorId: 'mov-cpu-1', instr: 'mov-cpu-1' },
+  { t: 'finishExecution', actorId: 'toggle-pickup', instr: 'toggle-pickup' },
+  // victim can't be picked up any more, so this one fails
+  { t: 'finishExecution', actorId: 'toggle-pickup', instr: 'toggle-pickup' },
+  { t: 'finishExecution', actorId: 'mov-cpu-1', instr: 'mov-cpu-1' },
+];
+
+describe('reduceDueActions', () => {
+  afterEach(() => {
+    setExecBatchRunner((items, steps) => runExecBatch(compiledPrograms(), items, steps));
+  });
+
+  test(`should agree with reducing actions one at a time`, () => {
+    const state = gameStateOfFs(fs);
+
+    let expected = state;
+    let expectedEffects: Effect[] = [];
+    for (const action of actions) {
+      let effects;
+      [expected, effects] = reduceGameState(expected, action);
+      expectedEffects = [...expectedEffects, ...effects];
+    }
+
+    const batches: number[] = [];
+    setExecBatchRunner((items, steps) => {
+      const numDone = runExecBatch(compiledPrograms(), items, steps);
+      batches.push(numDone);
+      return numDone;
+    });
+    const [actual, actualEffects] = reduceDueActions(state, actions);
+
+    expect(actual).toEqual(expected);
+    expect(actualEffects).toEqual(expectedEffects);
+    // Stops before the failing toggle, which goes the usual way
+    expect(batches).toEqual([4, 1]);
+  });
+});
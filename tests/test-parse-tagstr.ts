@@ -36,4 +36,17 @@ describe('screen utilities', () => {
     ]);
 
   });
+
+  test('should truncate and pad tag lines', () => {
+    const attr = { fg: ColorCode.bwhite, bg: ColorCode.black };
+    const screen = new Screen(attr);
+    const row = (y: number, len: number) => [...Array(len).keys()].map(x => screen.getChar(x, y));
+
+    screen.drawTagLine(screen.at(0, 0), 4, '{red}ab{/}cdef', attr);
+    expect(row(0, 5).map(c => String.fromCharCode(c.charcode)).join('')).toEqual('abcd\0');
+    expect(row(0, 4).map(c => c.fg)).toEqual([ColorCode.red, ColorCode.red, ColorCode.bwhite, ColorCode.bwhite]);
+
+    screen.drawTagLine(screen.at(0, 1), 5, '{lock}x', attr);
+    expect(row(1, 5).map(c => String.fromCharCode(c.charcode)).join('')).toEqual(Chars.LOCK + 'x   ');
+  });
 });
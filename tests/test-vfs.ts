@@ -1,11 +1,18 @@
+import { gameStateOfFs, getCurId, getCurLine } from '../src/core/model';
+import { reduceFsKeyAction } from '../src/core/reduce';
 import { getContents, getFullContents, getItem, insertPlans, mkFs } from '../src/fs/fs';
 import { SpecialId } from '../src/fs/initial-fs';
+import { setVirtualPlanner, virtualPlans } from '../src/fs/vfs';
 import { testFile } from "./testing-utils";
 
 const jestConsole = console;
 
 
 describe('virtual filesystem', () => {
+  afterEach(() => {
+    setVirtualPlanner(virtualPlans);
+  });
+
   test('should work correctly', () => {
 
     const fs = (() => {
@@ -61,4 +68,67 @@ describe('virtual filesystem', () => {
         'foo_a',
       ]);
   });
+
+  test('should generate a directory\'s children in one batch', () => {
+
+    const batches: string[][] = [];
+    setVirtualPlanner(paths => {
+      batches.push(paths);
+      return virtualPlans(paths);
+    });
+
+    const fs = (() => {
+      let fs = mkFs();
+      [fs,] = insertPlans(fs, SpecialId.root, [
+        { t: 'virtual', id: 'vroot' },
+      ]);
+      return fs;
+    })();
+
+    expect(getFullContents(fs, '_gen_vroot').map(x => x.name))
+      .toEqual([
+        "gbar",
+        "zdbaz",
+        "sfoo",
+        "gbaz",
+        "jgbaz",
+        '\x81\x95\x83\x9D\x95'
+      ]);
+    expect(batches.map(batch => batch.length)).toEqual([1, 6]);
+
+    // Everything is cached now
+    getFullContents(fs, '_gen_vroot');
+    expect(batches.length).toBe(2);
+  });
+
+  test('shouldn\'t carry changes to virtual items across reboots', () => {
+
+    const boot = () => {
+      let fs = mkFs();
+      [fs,] = insertPlans(fs, SpecialId.root, [
+        { t: 'virtual', id: 'vroot' },
+      ]);
+      return gameStateOfFs(fs);
+    };
+
+    // Go into the virtual directory, move down, and come back out,
+    // which remembers the line we were on.
+    let state = boot();
+    [state] = reduceFsKeyAction(state, 'exec');
+    expect(getCurId(state)).toEqual('_gen_vroot');
+    [state] = reduceFsKeyAction(state, 'nextLine');
+    [state] = reduceFsKeyAction(state, 'nextLine');
+    [state] = reduceFsKeyAction(state, 'back');
+    expect(getItem(state.fs, '_gen_vroot').stickyCurrentPos).toEqual(2);
+
+    let rebooted = boot();
+    expect(getItem(rebooted.fs, '_gen_vroot').stickyCurrentPos).toBeUndefined();
+    [rebooted] = reduceFsKeyAction(rebooted, 'exec');
+    expect(getCurId(rebooted)).toEqual('_gen_vroot');
+    expect(getCurLine(rebooted)).toEqual(0);
+
+    // and the old state still has it
+    [state] = reduceFsKeyAction(state, 'exec');
+    expect(getCurLine(state)).toEqual(2);
+  });
 });